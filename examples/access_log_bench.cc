@@ -0,0 +1,96 @@
+// 访问日志吞吐测试：
+//   format 后台线程格式化一条记录的耗时
+//   以固定的速率持续写入 seconds 秒，统计每次调用 Record 的平均耗时和丢弃的记录数
+//
+// usage: access_log_bench [lines_per_second] [seconds]
+// 每种格式写出到 access_log_bench.<format>.log
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http/access_log.h"
+
+using namespace skyline::http;
+
+static AccessLogEntry makeEntry(int i) {
+    AccessLogEntry entry;
+    entry.time = std::chrono::system_clock::now().time_since_epoch().count();
+    entry.latency_us = 100 + i % 900;
+    entry.status = i % 50 == 0 ? 404 : 200;
+    entry.method = HttpMethod::HTTP_GET;
+    entry.peer.sin_addr.s_addr = htonl(0x0a000001 + i % 256);
+    entry.peer.sin_port = htons(40000 + i % 20000);
+    entry.bytes = 512 + i % 4096;
+    entry.path = "/api/v1/items/12345";
+    entry.query = "page=2&size=20";
+    entry.referer = "https://example.com/list";
+    entry.user_agent = "Mozilla/5.0 (X11; Linux x86_64) access_log_bench";
+    return entry;
+}
+
+// 后台线程格式化一条记录的耗时，决定了能持续写出的上限
+static void benchFormat(const char* name, AccessLogFormat format, int n) {
+    using namespace std::chrono;
+    auto entry = makeEntry(0);
+    std::string out;
+    size_t bytes = 0;
+    const auto start = steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        out.clear();
+        AccessLog::Format(out, format, entry);
+        bytes += out.size();
+    }
+    const auto ns = duration<double, std::nano>(steady_clock::now() - start)
+                        .count() /
+                    n;
+    printf("%-8s format: %6.1f ns/line  (%5.0fk lines/s, %zu bytes/line)\n",
+           name, ns, 1e6 / ns, bytes / n);
+}
+
+// 每毫秒写入 rate / 1000 条记录，模拟反应堆线程持续产生的访问日志
+static void bench(const char* name, AccessLogFormat format, int rate,
+                  int seconds) {
+    using namespace std::chrono;
+    const auto filename = std::string("access_log_bench.") + name + ".log";
+    std::remove(filename.c_str());
+
+    const int per_tick = rate / 1000;
+    const int ticks = seconds * 1000;
+    double call_ns = 0;
+    uint64_t dropped = 0;
+    {
+        AccessLog log({.filename = filename, .format = format});
+        std::vector<AccessLogEntry> entries;
+        for (int i = 0; i < per_tick; ++i) entries.push_back(makeEntry(i));
+        auto next = steady_clock::now();
+        for (int t = 0; t < ticks; ++t) {
+            const auto begin = steady_clock::now();
+            for (auto& entry : entries) log.Record(entry);
+            call_ns +=
+                duration<double, std::nano>(steady_clock::now() - begin)
+                    .count();
+            next += milliseconds(1);
+            std::this_thread::sleep_until(next);
+        }
+        dropped = log.droppedCount();
+    }
+    printf("%-8s %d lines/s for %ds    call: %6.1f ns/record    dropped: %lu\n",
+           name, rate, seconds,
+           call_ns / (static_cast<double>(per_tick) * ticks), dropped);
+}
+
+int main(int argc, char** argv) {
+    const int rate = argc > 1 ? std::stoi(argv[1]) : 500000;
+    const int seconds = argc > 2 ? std::stoi(argv[2]) : 3;
+    benchFormat("common", AccessLogFormat::COMMON, 1000000);
+    benchFormat("combined", AccessLogFormat::COMBINED, 1000000);
+    benchFormat("json", AccessLogFormat::JSON, 1000000);
+    bench("common", AccessLogFormat::COMMON, rate, seconds);
+    bench("combined", AccessLogFormat::COMBINED, rate, seconds);
+    bench("json", AccessLogFormat::JSON, rate, seconds);
+    return 0;
+}
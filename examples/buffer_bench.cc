@@ -0,0 +1,50 @@
+// 缓冲区追加测试
+// 每次追加 4KB，统计写满 total 字节的耗时与重新分配的次数，
+// drain 不为 0 时每次追加后读出 drain 字节，模拟发送缓冲区的慢读者
+//
+// usage: buffer_bench [total_mb] [drain_bytes]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "core/buffer.h"
+#include "core/memory_pool.h"
+
+using namespace skyline::core;
+
+static void Run(BufferPool* pool, size_t total, size_t drain) {
+    const std::string chunk(4096, 'x');
+    Buffer buf(pool);
+    size_t reallocs = 0;
+    size_t cap = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t written = 0; written < total; written += chunk.size()) {
+        if (!buf.WriteAll(chunk)) {
+            std::printf("write fail at %zu\n", written);
+            return;
+        }
+        if (buf.capacity() != cap) {
+            cap = buf.capacity();
+            ++reallocs;
+        }
+        buf.Retrieve(drain);
+    }
+    const std::chrono::duration<double> cost =
+        std::chrono::steady_clock::now() - start;
+    std::printf("%-6s total %5zu MB  drain %5zu  reallocs %6zu  %8.3f s  "
+                "size %zu  capacity %zu\n",
+                pool ? "pool" : "system", total >> 20, drain, reallocs,
+                cost.count(), buf.size(), buf.capacity());
+}
+
+int main(int argc, char** argv) {
+    const size_t total_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    const size_t drain = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0;
+    BufferPool pool;
+    for (size_t mb = 1; mb <= total_mb; mb *= 4) {
+        Run(&pool, mb << 20, drain);
+        Run(nullptr, mb << 20, drain);
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include "core/buffer.h"
 #include "core/channel.h"
 #include "core/event_loop.h"
+#include "core/reactor.h"
 #include "core/tcp_server.h"
 
 using namespace skyline::core;
@@ -13,10 +14,10 @@ class EchoServer : public TcpServer {
 public:
     using TcpServer::TcpServer;
 
-    void AfterConnect(std::shared_ptr<Channel> ctx) override {
+    void AfterConnect(const ChannelPtr& ctx) override {
         std::cout << ctx->fd() << " connected!\n";
     }
-    void OnRecv(std::shared_ptr<Channel> ctx, ReadBuffer& buf) override {
+    void OnRecv(const ChannelPtr& ctx, ReadBuffer& buf) override {
         const auto massage = buf.ReadAll();
         std::cout << ctx->fd() << " recv: " << massage << '\n';
         ctx->SendMassage(massage);
@@ -24,12 +25,16 @@ public:
 };
 
 int main() {
-    EchoServer server(::sockaddr_in{
-        .sin_family = AF_INET,
-        .sin_port = htons(8888),
-        .sin_addr = {.s_addr = htonl(INADDR_ANY)},
-    });
+    Reactor reactor;
+    EchoServer server(
+        ::sockaddr_in{
+            .sin_family = AF_INET,
+            .sin_port = htons(8888),
+            .sin_addr = {.s_addr = htonl(INADDR_ANY)},
+        },
+        reactor);
 
-    server.Start();
+    server.StartListen();
+    reactor.Start();
     return 0;
 }
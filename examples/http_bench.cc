@@ -0,0 +1,89 @@
+// 简单的 HTTP 压测客户端，每个请求使用一个短连接
+// 输出 QPS 以及成功请求的平均、p50、p99 延迟（包括建立连接）
+//
+// usage: http_bench <ip> <port> [connections] [seconds] [path]
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic_uint64_t succeed{0};
+static std::atomic_uint64_t failed{0};
+
+static bool request(const sockaddr_in& addr, const std::string& req) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) return false;
+    bool ok = false;
+    if (::connect(fd, (const sockaddr*)&addr, sizeof addr) == 0 &&
+        ::write(fd, req.data(), req.size()) == req.size()) {
+        // 服务器发送完响应后关闭连接
+        char buf[4096];
+        std::string res;
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0) res.append(buf, n);
+        ok = res.starts_with("HTTP/1.1 200");
+    }
+    ::close(fd);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s ip port [connections] [seconds] [path]\n",
+                argv[0]);
+        return 1;
+    }
+    sockaddr_in addr{
+        .sin_family = AF_INET,
+        .sin_port = htons(std::stoul(argv[2])),
+    };
+    ::inet_pton(AF_INET, argv[1], &addr.sin_addr);
+    const unsigned int conns = argc > 3 ? std::stoul(argv[3]) : 64;
+    const unsigned int seconds = argc > 4 ? std::stoul(argv[4]) : 10;
+    const std::string path = argc > 5 ? argv[5] : "/";
+    const std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + argv[1] +
+                            "\r\nConnection: close\r\n\r\n";
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    std::vector<std::thread> threads;
+    // 每个线程记录自己的延迟，结束后合并，单位微秒
+    std::vector<std::vector<uint32_t>> latencies(conns);
+    for (unsigned int i = 0; i < conns; ++i) {
+        threads.emplace_back([&, i]() {
+            using namespace std::chrono;
+            while (steady_clock::now() < deadline) {
+                const auto start = steady_clock::now();
+                if (request(addr, req)) {
+                    ++succeed;
+                    latencies[i].push_back(
+                        duration_cast<microseconds>(steady_clock::now() - start)
+                            .count());
+                } else {
+                    ++failed;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    printf("Requests: %lu succeed, %lu failed.\n", succeed.load(),
+           failed.load());
+    printf("avg QPS: %.1f\n", static_cast<double>(succeed) / seconds);
+    std::vector<uint32_t> all;
+    for (auto& v : latencies) all.insert(all.end(), v.begin(), v.end());
+    if (!all.empty()) {
+        std::sort(all.begin(), all.end());
+        double sum = 0;
+        for (auto us : all) sum += us;
+        printf("latency: avg %.0fus, p50 %uus, p99 %uus\n", sum / all.size(),
+               all[all.size() / 2], all[all.size() * 99 / 100]);
+    }
+    return 0;
+}
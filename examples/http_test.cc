@@ -1,6 +1,13 @@
+#include <limits.h>
 #include <signal.h>
+#include <unistd.h>
 
+#include <thread>
+
+#include "core/channel.h"
+#include "core/coroutine.h"
 #include "core/event_loop.h"
+#include "core/listener_handoff.h"
 #include "core/reactor.h"
 #include "core/utils.h"
 #include "http/http_server.h"
@@ -9,22 +16,53 @@
 using namespace skyline::core;
 using namespace skyline::http;
 
-Reactor* reactor_ptr{};
 auto& kLogger = skyline::logger::getRootLogger();
 
-void sigint_handler(int sig) {
-    if (sig == SIGINT) {
+static constexpr char kHandoffPath[] = "/tmp/skyline_http_test.sock";
+static constexpr std::time_t kDrainTimeout = 5000;
+
+// SIGINT：优雅退出
+// SIGUSR2：启动新进程并把监听 socket 交给它，然后优雅退出，实现不停机重启
+void signal_loop(sigset_t set, char** argv, HttpServer& server,
+                 Reactor& reactor) {
+    while (true) {
+        int sig = 0;
+        if (::sigwait(&set, &sig) != 0) continue;
+        if (sig == SIGUSR2) {
+            // 先绑定交接 socket，再启动新进程，保证新进程一定能连上
+            ListenerHandoff handoff(kHandoffPath);
+            pid_t pid = ::fork();
+            if (pid == 0) {
+                // 使用真实路径而非 /proc/self/exe，保持新进程的进程名不变
+                char path[PATH_MAX]{};
+                if (::readlink("/proc/self/exe", path, sizeof path - 1) > 0) {
+                    ::execv(path, argv);
+                }
+                ::_exit(1);
+            }
+            if (pid == -1 || !handoff.Send({server.listenFd()}, 5000)) {
+                SKYLINE_LOG_ERROR(kLogger) << "restart fail";
+                continue;
+            }
+        }
         SKYLINE_LOG_INFO(kLogger) << "stop server...";
-        if (reactor_ptr != nullptr) reactor_ptr->Stop();
+        server.Shutdown(kDrainTimeout, [&reactor]() { reactor.Stop(); });
+        return;
     }
 }
 
-int main() {
+int main(int argc, char** argv) {
     std::stringstream ss;
-    signal(SIGINT, sigint_handler);
+    // 在创建任何线程之前屏蔽信号，统一由信号线程处理
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGUSR2);
+    ::pthread_sigmask(SIG_BLOCK, &set, nullptr);
 
     Reactor reactor(4);
-    reactor_ptr = &reactor;
+    // 新连接优先分配给连接数最少的子反应堆
+    reactor.setPlacementPolicy(std::make_unique<LeastConnectionsPolicy>());
     HttpServer server(
         ::sockaddr_in{
             .sin_family = AF_INET,
@@ -48,8 +86,53 @@ int main() {
             res.body = "Glob\r\n" + ss.str();
             return 0;
         });
-    server.StartListen();
+    // offload servlet：在工作线程池中执行耗时的同步处理
+    server.dispatch.addServlet(
+        "/skyline/heavy",
+        [](const HttpRequest& req, HttpResponse& res, auto session) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            res.body = "Offload\r\n";
+            return 0;
+        },
+        true);
+    // 异步 servlet：在其它线程中稍后完成请求，不阻塞子反应堆
+    server.dispatch.addAsyncServlet(
+        "/skyline/async",
+        [](const HttpRequest& req, HttpCompletion completion, auto session) {
+            std::thread([completion]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                completion.response().body = "Async\r\n";
+                completion.complete();
+            }).detach();
+        });
+    // 协程 servlet：等待定时器期间不阻塞 EventLoop
+    server.dispatch.addCoroutineServlet(
+        "/skyline/co",
+        [](const HttpRequest& req, HttpResponse& res,
+           ChannelPtr session) -> Task<int> {
+            co_await Sleep(session->loop(), 10);
+            res.body = "Coroutine\r\n";
+            co_return 0;
+        });
+    // 连接数达到上限时暂停 accept，事件循环过载时直接返回 503
+    server.setConnectionLimits({
+        .max_connections = 10000,
+        .overload_lag_usec = 20000,
+    });
+    // 访问日志由后台线程格式化写出，不影响请求的处理
+    server.setAccessLog({.filename = "http_access.log",
+                         .format = AccessLogFormat::COMBINED});
+    // 由旧进程启动时接管其监听 socket，否则自行监听
+    auto fds = ListenerHandoff::Receive(kHandoffPath);
+    if (fds.empty()) {
+        server.StartListen();
+    } else {
+        server.StartListen(fds.front());
+    }
+    std::thread signal_thread(signal_loop, set, argv, std::ref(server),
+                              std::ref(reactor));
     getSystemLogger().level = skyline::logger::LogLevel::ERROR;
     reactor.Start();
+    signal_thread.join();
     return 0;
 }
@@ -0,0 +1,157 @@
+// 空闲连接内存占用测试
+// 在进程内启动服务器，建立 n 条连接，每条连接完成一次请求后保持空闲，
+// 统计服务器每条空闲连接占用的常驻内存（RSS 增量 / n）
+//
+// usage: idle_conn_bench [tcp|http] [connections] [sub_reactors]
+//   tcp   TcpServer 回显一次消息
+//   http  HttpServer 处理一次 keep-alive 请求
+// 客户端与服务器在同一进程内，连接数受 RLIMIT_NOFILE 限制（每条连接两个 fd）
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/buffer.h"
+#include "core/reactor.h"
+#include "core/utils.h"
+#include "http/http_server.h"
+
+using namespace skyline::core;
+using namespace skyline::http;
+
+static std::atomic_size_t connected{0};
+
+class EchoServer : public TcpServer {
+public:
+    using TcpServer::TcpServer;
+
+protected:
+    void AfterConnect(const ChannelPtr& ctx) override { ++connected; }
+    void OnRecv(const ChannelPtr& ctx, ReadBuffer& buf) override {
+        ctx->SendMassage(buf.ReadAll());
+    }
+};
+
+class CountingHttpServer : public HttpServer {
+public:
+    using HttpServer::HttpServer;
+
+    void AfterConnect(const ChannelPtr& ctx) override {
+        HttpServer::AfterConnect(ctx);
+        ++connected;
+    }
+};
+
+// 当前进程的常驻内存，单位字节
+static size_t rss() {
+    size_t pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+static void waitFor(const std::function<bool()>& cond) {
+    while (!cond()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // 留出时间让反应堆处理完剩余事件
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
+
+int main(int argc, char** argv) {
+    const std::string mode = argc > 1 ? argv[1] : "http";
+    size_t conns = argc > 2 ? std::stoul(argv[2]) : 8000;
+    const unsigned int subs = argc > 3 ? std::stoul(argv[3]) : 1;
+    if (mode != "tcp" && mode != "http") {
+        fprintf(stderr, "usage: %s [tcp|http] [connections] [sub_reactors]\n",
+                argv[0]);
+        return 1;
+    }
+
+    rlimit limit{};
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    if (conns * 2 + 64 > limit.rlim_cur) {
+        conns = (limit.rlim_cur - 64) / 2;
+        printf("RLIMIT_NOFILE is %lu, connections limited to %zu\n",
+               limit.rlim_cur, conns);
+    }
+    getSystemLogger().level = skyline::logger::LogLevel::WARN;
+
+    const sockaddr_in addr{
+        .sin_family = AF_INET,
+        .sin_port = htons(8891),
+        .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)},
+    };
+    Reactor reactor(ReactorOptions{.sub_reactor_num = subs});
+    std::unique_ptr<TcpServer> server;
+    if (mode == "tcp") {
+        server = std::make_unique<EchoServer>(addr, reactor);
+    } else {
+        auto http = std::make_unique<CountingHttpServer>(addr, reactor);
+        http->is_keepalive = true;
+        // 测试期间不因空闲超时关闭连接
+        http->idle_timeout = 3600 * 1000;
+        http->dispatch.addGlobServlet(
+            "/*", [](const HttpRequest& req, HttpResponse& res, auto session) {
+                res.body = "Hello Skyline\r\n";
+                return 0;
+            });
+        server = std::move(http);
+    }
+    server->StartListen();
+    std::thread reactor_thread([&]() { reactor.Start(); });
+    waitFor([]() { return true; });
+
+    const auto base = rss();
+    std::vector<int> fds;
+    fds.reserve(conns);
+    for (size_t i = 0; i < conns; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1 || ::connect(fd, (const sockaddr*)&addr, sizeof addr)) {
+            fprintf(stderr, "connect fail: %s\n", strerror(errno));
+            return 1;
+        }
+        fds.push_back(fd);
+    }
+    waitFor([&]() { return connected == conns; });
+    const auto after_connect = rss();
+
+    // 每条连接完成一次请求，之后保持空闲
+    const std::string req =
+        mode == "tcp" ? std::string(512, 'x')
+                      : "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    size_t failed = 0;
+    for (auto fd : fds) {
+        char buf[4096];
+        if (::write(fd, req.data(), req.size()) != req.size() ||
+            ::read(fd, buf, sizeof buf) <= 0) {
+            ++failed;
+        }
+    }
+    waitFor([]() { return true; });
+    const auto after_request = rss();
+
+    const auto per_conn = [conns](size_t from, size_t to) {
+        return to > from ? static_cast<double>(to - from) / conns : 0.0;
+    };
+    printf("mode: %s, connections: %zu, failed requests: %zu\n", mode.c_str(),
+           conns, failed);
+    printf("rss before: %.1f MiB\n", base / 1048576.0);
+    printf("idle after connect: %.0f bytes/conn\n",
+           per_conn(base, after_connect));
+    printf("idle after request: %.0f bytes/conn\n",
+           per_conn(base, after_request));
+
+    for (auto fd : fds) ::close(fd);
+    waitFor([]() { return true; });
+    reactor.Stop();
+    reactor_thread.join();
+    return 0;
+}
@@ -0,0 +1,189 @@
+// 日志写入开销测试，统计写日志的线程每次调用的平均耗时
+// 以及包括后台线程写完文件在内的总耗时
+//
+// usage: log_bench [threads] [logs_per_thread]
+//   stream  SKYLINE_LOG 流式输出到 AsyncFileAppender
+//   printf  LOG_FMT 格式化输出到 AsyncFileAppender
+//   format  LOG_FORMAT 格式化输出到 AsyncFileAppender
+//   binary  SKYLINE_BLOG 由后台线程格式化后输出到 AsyncFileAppender
+//   binfile SKYLINE_BLOG 直接写出二进制文件，之后用 log_decoder 解码
+// 另外对比运行期解析的 LogFormatter、编译期解析的 StaticLogFormatter 和
+// JsonLogFormatter 格式化一条日志的耗时，以及逐字节与向量化的 JSON 转义
+// 在不同长度内容上的吞吐
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger/async_log.h"
+#include "logger/binary_log.h"
+#include "logger/json_log.h"
+
+using namespace skyline::logger;
+
+static void bench(const char* name, int threads, int n,
+                  const std::function<void(int)>& log,
+                  const std::function<void()>& stop) {
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    std::vector<std::thread> workers;
+    std::vector<double> call_ns(threads);
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            const auto begin = steady_clock::now();
+            for (int i = 0; i < n; ++i) log(i);
+            call_ns[t] =
+                duration<double, std::nano>(steady_clock::now() - begin)
+                    .count() /
+                n;
+        });
+    }
+    for (auto& w : workers) w.join();
+    stop();
+    const auto total = duration<double, std::nano>(steady_clock::now() - start)
+                           .count() /
+                       (static_cast<double>(threads) * n);
+    double sum = 0;
+    for (auto ns : call_ns) sum += ns;
+    printf("%-8s call: %8.1f ns/log    total: %8.1f ns/log\n", name,
+           sum / threads, total);
+}
+
+template <typename Formatter>
+static void benchFormat(const char* name, const Formatter& formatter, int n) {
+    using namespace std::chrono;
+    Logger logger("bench");
+    LogEvent event("GET /index.html 200");
+    std::string out;
+    size_t bytes = 0;
+    const auto start = steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        out.clear();
+        event.line = i;
+        formatter.format(out, logger, LogLevel::INFO, event);
+        bytes += out.size();
+    }
+    const auto ns =
+        duration<double, std::nano>(steady_clock::now() - start).count() / n;
+    printf("%-8s format: %6.1f ns/log (%zu bytes)\n", name, ns, bytes);
+}
+
+// 逐字节判断的转义，作为向量化扫描的对照
+static void appendEscapedScalar(std::string& out, std::string_view s) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    for (const char ch : s) {
+        const auto c = static_cast<unsigned char>(ch);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (c < 0x20 || c == 0x7f) {
+            out.append("\\u00");
+            out += kHex[c >> 4];
+            out += kHex[c & 0xf];
+        } else {
+            out += ch;
+        }
+    }
+}
+
+// 内容为可打印字符，每 escape_every 字节有一个引号
+template <typename Escape>
+static void benchEscape(const char* name, size_t len, size_t escape_every,
+                        Escape&& escape) {
+    using namespace std::chrono;
+    std::string payload(len, 'x');
+    for (size_t i = 0; i < len; ++i) payload[i] = "abcdefgh /:=-_.0123"[i % 19];
+    for (size_t i = escape_every - 1; i < len; i += escape_every) {
+        payload[i] = '"';
+    }
+    const size_t n = std::max<size_t>(1, (256 << 20) / len);
+    std::string out;
+    const auto start = steady_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        out.clear();
+        escape(out, payload);
+    }
+    const auto ns = duration<double, std::nano>(steady_clock::now() - start)
+                        .count() /
+                    n;
+    printf("%-8s escape %6zu bytes: %9.1f ns  (%6.2f GB/s)\n", name, len, ns,
+           len / ns);
+}
+
+#define BENCH_PATTERN "%d{%Y-%m-%d %H:%M:%S}%T%t%T[%p]%T[%c]%T%f:%l%T%m%n"
+
+int main(int argc, char** argv) {
+    const int threads = argc > 1 ? std::stoi(argv[1]) : 4;
+    const int n = argc > 2 ? std::stoi(argv[2]) : 200000;
+    const std::string path = "/index.html";
+    printf("threads: %d, logs per thread: %d\n", threads, n);
+
+    benchFormat("runtime", LogFormatter(BENCH_PATTERN), n);
+    benchFormat("static", StaticLogFormatter<BENCH_PATTERN>(), n);
+    benchFormat("json", JsonLogFormatter(), n);
+    for (size_t len : {64, 1024, 65536}) {
+        benchEscape("scalar", len, 4096, appendEscapedScalar);
+        benchEscape("simd", len, 4096, detail::appendJsonEscaped);
+    }
+
+    {
+        Logger logger("bench");
+        auto appender =
+            std::make_shared<AsyncFileAppender>("log_bench.stream.log", false);
+        logger.addAppender(appender);
+        bench(
+            "stream", threads, n,
+            [&](int i) {
+                SKYLINE_LOG_INFO(logger)
+                    << "GET " << path << " " << 200 << " " << i;
+            },
+            [&]() { appender->stop(); });
+    }
+    {
+        Logger logger("bench");
+        auto appender =
+            std::make_shared<AsyncFileAppender>("log_bench.printf.log", false);
+        logger.addAppender(appender);
+        bench(
+            "printf", threads, n,
+            [&](int i) {
+                LOG_FMT_INFO(logger, "GET %s %d %d", path.c_str(), 200, i);
+            },
+            [&]() { appender->stop(); });
+    }
+    {
+        Logger logger("bench");
+        auto appender =
+            std::make_shared<AsyncFileAppender>("log_bench.format.log", false);
+        logger.addAppender(appender);
+        bench(
+            "format", threads, n,
+            [&](int i) { LOG_FORMAT_INFO(logger, "GET {} {} {}", path, 200, i); },
+            [&]() { appender->stop(); });
+    }
+    {
+        Logger logger("bench");
+        auto appender =
+            std::make_shared<AsyncFileAppender>("log_bench.binary.log", false);
+        logger.addAppender(appender);
+        BinaryLogger blog(logger);
+        bench(
+            "binary", threads, n,
+            [&](int i) { SKYLINE_BLOG_INFO(blog, "GET %s %d %d", path, 200, i); },
+            [&]() {
+                blog.stop();
+                appender->stop();
+            });
+    }
+    {
+        BinaryLogger blog("bench", "log_bench.blog");
+        bench(
+            "binfile", threads, n,
+            [&](int i) { SKYLINE_BLOG_INFO(blog, "GET %s %d %d", path, 200, i); },
+            [&]() { blog.stop(); });
+    }
+    return 0;
+}
@@ -0,0 +1,30 @@
+// 将 BinaryLogger 写出的二进制日志解码为文本
+//
+// usage: log_decoder <file> [pattern]
+//   pattern 为 LogFormatter 的格式，默认与控制台输出相同
+#include <fstream>
+#include <iostream>
+
+#include "logger/binary_log.h"
+
+using namespace skyline::logger;
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file [pattern]\n", argv[0]);
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "open %s fail\n", argv[1]);
+        return 1;
+    }
+    LogFormatter formatter(
+        argc > 2 ? argv[2] : "%d{%Y-%m-%d %H:%M:%S}%T%t%T[%p]%T[%c]%T%f:%l%T%m%n");
+    std::ios::sync_with_stdio(false);
+    if (!decodeBinaryLog(in, std::cout, formatter)) {
+        fprintf(stderr, "%s: invalid or truncated binary log\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "logger/async_log.h"
+#include "logger/json_log.h"
 
 using namespace skyline::logger;
 
@@ -12,6 +13,14 @@ int main() {
     SKYLINE_LOG_INFO(logger) << "a info log";
     LOG_FMT_DEBUG(logger, "format debug %d", 123);
     LOG_FMT_INFO(logger, "format info %d", 456);
+    // {} 占位符的数量与参数不一致时编译失败
+    LOG_FORMAT_INFO(logger, "format {} {}", "info", 789);
+
+    // 限流与采样：每个调用处每秒最多输出 10 条；以 1% 的概率输出
+    for (int i = 0; i < 100; ++i) {
+        SKYLINE_LOG_LIMIT_WARN(logger, 10) << "rate limited log " << i;
+        SKYLINE_LOG_SAMPLE(logger, LogLevel::INFO, 0.01) << "sampled log " << i;
+    }
 
     // 测试等级控制
     logger.level = LogLevel::INFO;
@@ -19,10 +28,12 @@ int main() {
     SKYLINE_LOG_INFO(logger) << "should output info log";
 
     // 测试格式化器
+    // 格式固定时也可以使用编译期解析的 StaticLogFormatter<"%c%T[%p]%T%m%n">
     auto simple_formatter = std::make_shared<LogFormatter>("%c%T[%p]%T%m%n");
     auto stdout_appender =
         std::make_shared<StdoutLogAppender>(simple_formatter);
-    auto& mini_logger = getLogger("custom");  // 后续测试的输出地都加入此日志器
+    // 后续测试的输出地都加入此日志器，频繁使用时也可以用 SKYLINE_LOGGER("custom")
+    auto& mini_logger = getLogger("custom");
     mini_logger.addAppender(stdout_appender);
 
     SKYLINE_LOG_INFO(mini_logger) << "should output like: `custom [INFO] ...`";
@@ -38,7 +49,10 @@ int main() {
     // 测试基本异步文件日志
     auto async_appender =
         std::make_shared<AsyncFileAppender>("logger_async_test.log", false);
+    // 第三个参数 LogFileOptions 可以选择 O_DIRECT、刷新时的持久化方式等
     // 这里使用默认格式化器
+    // 每个线程的缓冲区写满时默认等待，也可以选择丢弃并统计丢弃的条数
+    async_appender->setFullPolicy(RingFullPolicy::DROP_COUNTED);
     mini_logger.addAppender(async_appender);
 
     // 下面的这条日志将出现在3个地方，且异步日志中的输出格式与其它两个不同
@@ -46,7 +60,24 @@ int main() {
         << "should output into console and file `logger_async_test.log` and "
            "`logger_test.log`";
 
-    // 异步滚动日志不测了，使用方法基本相同（要达到滚动的效果需要不少的日志，且大于1秒的输出时间才能看到效果）
+    // 测试结构化日志：field 附加的字段在文本格式中输出为 key=value，
+    // JsonLogFormatter 每条日志输出一行 JSON，字符串都经过转义
+    auto json_appender = std::make_shared<StdoutLogAppender>();
+    json_appender->setFormatter(std::make_shared<JsonLogFormatter>());
+    auto& json_logger = getLogger("json");
+    json_logger.addAppender(json_appender);
+    SKYLINE_LOG_INFO(json_logger)
+        << "should output one \"json\" line" << field("status", 200)
+        << field("path", "/index.html") << field("cached", true);
+
+    // 异步滚动日志不测了，使用方法基本相同（要达到滚动的效果需要不少的日志）
+    // 可以按大小、按时间滚动，限制保留的文件数，并在后台压缩滚动后的文件：
+    // LogRollOptions options{.limit_size = 64 << 20,
+    //                        .interval = std::chrono::hours(24),
+    //                        .max_files = 30,
+    //                        .compress = true};
+    // auto roll_appender = std::make_shared<AsyncRollFileAppender>(
+    //     "logger_roll_test", options, false);
 
     return 0;
 }
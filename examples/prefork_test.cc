@@ -0,0 +1,91 @@
+// 多进程模式与多线程模式的对比测试服务器
+//
+// usage: prefork_test <mode> [num] [port]
+//   threads   单进程，1 个主反应堆 + num 个子反应堆
+//   prefork   master 监听，num 个 worker 进程继承监听 socket
+//   reuseport num 个 worker 进程各自使用 SO_REUSEPORT 监听
+//
+// 配合 http_bench 使用，例如：
+//   ./prefork_test prefork 4 8890 & ./http_bench 127.0.0.1 8890 64 10
+#include <signal.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "core/prefork.h"
+#include "core/reactor.h"
+#include "core/utils.h"
+#include "http/http_server.h"
+
+using namespace skyline::core;
+using namespace skyline::http;
+
+static constexpr std::time_t kDrainTimeout = 1000;
+
+// 运行一个 HTTP 服务器直到收到 SIGINT/SIGTERM
+// listen_fd 为 -1 时自行监听
+static int serve(unsigned int sub_reactor_num, const sockaddr_in& addr,
+                 int listen_fd, bool reuse_port) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    ::pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    Reactor reactor(ReactorOptions{.sub_reactor_num = sub_reactor_num});
+    HttpServer server(addr, reactor);
+    server.dispatch.addGlobServlet(
+        "/*", [](const HttpRequest& req, HttpResponse& res, auto session) {
+            res.body = "Hello Skyline\r\n";
+            return 0;
+        });
+    server.setReusePort(reuse_port);
+    if (listen_fd == -1) {
+        server.StartListen();
+    } else {
+        server.StartListen(listen_fd);
+    }
+    std::thread signal_thread([&]() {
+        int sig = 0;
+        ::sigwait(&set, &sig);
+        server.Shutdown(kDrainTimeout, [&reactor]() { reactor.Stop(); });
+    });
+    reactor.Start();
+    signal_thread.join();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s threads|prefork|reuseport [num] [port]\n",
+                argv[0]);
+        return 1;
+    }
+    const std::string mode = argv[1];
+    const unsigned int num = argc > 2 ? std::stoul(argv[2]) : 4;
+    const uint16_t port = argc > 3 ? std::stoul(argv[3]) : 8890;
+    const sockaddr_in addr{
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr = {.s_addr = htonl(INADDR_ANY)},
+    };
+    getSystemLogger().level = skyline::logger::LogLevel::INFO;
+
+    if (mode == "threads") return serve(num, addr, -1, false);
+
+    Prefork prefork(PreforkOptions{.worker_num = num});
+    if (mode == "prefork") {
+        // master 只负责监听，worker 继承监听 socket
+        int listen_fd = TcpServer::CreateListenSocket(addr);
+        return prefork.Run([&](unsigned int id) {
+            return serve(0, addr, listen_fd, false);
+        });
+    }
+    if (mode == "reuseport") {
+        return prefork.Run(
+            [&](unsigned int id) { return serve(0, addr, -1, true); });
+    }
+    fprintf(stderr, "unknown mode: %s\n", mode.c_str());
+    return 1;
+}
@@ -1,40 +1,78 @@
 #include "buffer.h"
 
-static constexpr size_t kDefaultSize = 1024;
+#include <algorithm>
+#include <cstring>
 
-namespace skyline::core {
+#include "memory_pool.h"
 
-BaseBuffer::BaseBuffer() { data_.reserve(kDefaultSize); }
+namespace skyline::core {
 
-std::string ReadBuffer::ReadAll() {
-    std::string res = data_.substr(idx_);
-    idx_ = 0;
-    data_.clear();
+std::string Buffer::ReadAll() {
+    std::string res(data(), size());
+    Retrieve(res.size());
     return res;
 }
 
-std::string ReadBuffer::Read(size_t n) {
-    std::string res = data_.substr(idx_, n);
-    idx_ += res.size();
+std::string Buffer::Read(size_t n) {
+    std::string res(data(), std::min(n, size()));
+    Retrieve(res.size());
     return res;
 }
 
-void WriteBuffer::WriteAll(std::string_view data) {
-    const int end = data_.size() + data.size();
-    const int len = end - idx_;
-    if (end > data_.capacity()) {
-        if (len < data_.capacity()) {
-            data_.erase(0, idx_);
-            idx_ = 0;
-        } else {
-            data_.reserve(end + 1);
-        }
+void Buffer::Retrieve(size_t n) noexcept {
+    begin_ += std::min(n, size());
+    if (begin_ == end_) ReleaseBlock();
+}
+
+bool Buffer::WriteAll(std::string_view data) {
+    const auto n = data.size();
+    if (n == 0) return true;
+    const auto len = size();
+    // 偏移只有 32 位，超出时截断会破坏缓冲区
+    if (n > kMaxSize - len) return false;
+    if (end_ + n <= cap_) {
+        std::memcpy(block_ + end_, data.data(), n);
+        end_ += n;
+        return true;
     }
-    data_ += data;
+    // 前部已读出的空间足够且不少于要移动的数据时，移动数据即可，
+    // 否则每次只读出一点时每次追加都要移动全部数据
+    if (len + n <= cap_ && len <= begin_) {
+        std::memmove(block_, block_ + begin_, len);
+    } else {
+        // 至少翻倍，连续追加时总的复制量与数据量成正比；
+        // 超过池中最大的块后 Acquire 按请求的大小分配，不会自动扩大
+        const auto want = std::min<size_t>(
+            std::max<size_t>(len + n, 2 * static_cast<size_t>(cap_)),
+            kMaxSize);
+        size_t cap;
+        char* block = pool_ ? pool_->Acquire(want, cap)
+                            : new char[cap = std::max<size_t>(want, 1024)];
+        if (len > 0) std::memcpy(block, block_ + begin_, len);
+        ReleaseBlock();
+        block_ = block;
+        cap_ = cap;
+    }
+    begin_ = 0;
+    end_ = len + n;
+    std::memcpy(block_ + len, data.data(), n);
+    return true;
+}
+
+bool Buffer::Write(std::string_view data, size_t n) {
+    return WriteAll(data.substr(0, n));
 }
 
-void WriteBuffer::Write(std::string_view data, size_t n) {
-    WriteAll(data.substr(0, n));
+void Buffer::ReleaseBlock() noexcept {
+    if (block_ != nullptr) {
+        if (pool_) {
+            pool_->Release(block_, cap_);
+        } else {
+            delete[] block_;
+        }
+    }
+    block_ = nullptr;
+    cap_ = begin_ = end_ = 0;
 }
 
 }  // namespace skyline::core
@@ -1,34 +1,53 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 namespace skyline::core {
 
-class BaseBuffer {
+class BufferPool;
+
+// 数据保存在从 BufferPool 借来的内存块中，只有存在未读数据时才持有内存块，
+// 数据被全部取走后立即归还，空闲连接不占用缓冲区内存
+// pool 为空时直接向系统申请
+// 没有虚函数，空闲时只占 32 字节，单个缓冲区最多容纳 kMaxSize 字节
+class Buffer {
 public:
-    BaseBuffer();
-    virtual ~BaseBuffer() = default;
+    static constexpr size_t kMaxSize = UINT32_MAX;
 
-    size_t size() const noexcept { return data_.size() - idx_; }
-    const char* data() const noexcept { return data_.data() + idx_; }
+    explicit Buffer(BufferPool* pool = nullptr) noexcept : pool_(pool) {}
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    ~Buffer() { ReleaseBlock(); }
 
-protected:
-    std::string data_;
-    size_t idx_{0};
-};
+    size_t size() const noexcept { return end_ - begin_; }
+    const char* data() const noexcept { return block_ + begin_; }
+
+    // 当前持有的内存块大小，空闲时为 0
+    size_t capacity() const noexcept { return cap_; }
 
-class ReadBuffer : virtual public BaseBuffer {
-public:
     std::string ReadAll();
     std::string Read(size_t n);
+    // 丢弃至多 n 字节，数据为空时归还内存块
+    void Retrieve(size_t n) noexcept;
+
+    // 写入后超过 kMaxSize 时不写入并返回 false，调用方应关闭连接
+    [[nodiscard]] bool WriteAll(std::string_view data);
+    [[nodiscard]] bool Write(std::string_view data, size_t n);
+
+private:
+    void ReleaseBlock() noexcept;
+
+private:
+    BufferPool* pool_{nullptr};
+    char* block_{nullptr};
+    uint32_t cap_{0};
+    uint32_t begin_{0};
+    uint32_t end_{0};
 };
 
-class WriteBuffer : virtual public BaseBuffer {
-public:
-    void WriteAll(std::string_view data);
-    void Write(std::string_view data, size_t n);
-};
-
-class Buffer : public ReadBuffer, public WriteBuffer {};
+// 按用途区分的别名，例如 OnRecv 只从中读取数据
+using ReadBuffer = Buffer;
+using WriteBuffer = Buffer;
 
 }  // namespace skyline::core
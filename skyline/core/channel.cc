@@ -1,5 +1,6 @@
 #include "channel.h"
 
+#include "event_loop.h"
 #include "utils.h"
 
 namespace skyline::core {
@@ -8,7 +9,21 @@ Channel::Channel(EventLoop& loop, int fd) : fd_(fd), loop_(loop) {}
 
 Channel::~Channel() { Close(); }
 
+sockaddr_in Channel::peerAddr() const noexcept {
+    return {
+        .sin_family = AF_INET,
+        .sin_port = peer_port_,
+        .sin_addr = {.s_addr = peer_ip_},
+    };
+}
+
+void Channel::setPeerAddr(const sockaddr_in& addr) noexcept {
+    peer_ip_ = addr.sin_addr.s_addr;
+    peer_port_ = addr.sin_port;
+}
+
 void Channel::Close() {
+    closed_ = true;
     if (fd_ != -1) {
         SYSTEM_LOG_DEBUG << fd_ << " closed";
         ::close(fd_);
@@ -16,4 +31,36 @@ void Channel::Close() {
     }
 }
 
+ChannelHandle::ChannelHandle(const ChannelPtr& channel)
+    : channel_(channel.get()) {
+    if (channel_ && channel_->remote_refs_.fetch_add(1) == 0) {
+        channel_->AddRef();
+    }
+}
+
+ChannelHandle::ChannelHandle(const ChannelHandle& other) noexcept
+    : channel_(other.channel_) {
+    if (channel_) channel_->remote_refs_.fetch_add(1);
+}
+
+ChannelHandle ChannelHandle::Retain(Channel* channel) noexcept {
+    ChannelHandle handle;
+    handle.channel_ = channel;
+    channel->remote_refs_.fetch_add(1);
+    return handle;
+}
+
+void ChannelHandle::reset() noexcept {
+    auto channel = std::exchange(channel_, nullptr);
+    if (channel && channel->remote_refs_.fetch_sub(1) == 1) {
+        channel->loop().RunInLoop([channel]() { channel->Release(); });
+    }
+}
+
+void ChannelHandle::Post(std::function<void(const ChannelPtr&)> func) const {
+    loop().RunInLoop([handle = *this, func = std::move(func)]() {
+        func(handle.get());
+    });
+}
+
 }  // namespace skyline::core
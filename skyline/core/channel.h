@@ -1,36 +1,112 @@
 #pragma once
 
+#include <netinet/in.h>
+
+#include <atomic>
 #include <functional>
 #include <memory>
 
+#include "ref_counted.h"
+
 namespace skyline::core {
 
-class ReadBuffer;
 class EventLoop;
 
+class Channel;
+class ChannelHandle;
+
+// 只能在 Channel 所属的 EventLoop 线程中复制、销毁
+using ChannelPtr = RefPtr<Channel>;
+
 // 管理一个 socket fd 的生命周期
 // 提供 消息回调注册，关闭前回调注册，消息发送方法
-class Channel {
+// 使用非原子的侵入式引用计数，跨线程持有时使用 ChannelHandle
+class Channel : public RefCounted {
 public:
     Channel(EventLoop& loop, int fd);
     Channel(const Channel&) = delete;
     Channel(Channel&&) = delete;
     virtual ~Channel();
 
+    // 在非所属 EventLoop 线程中调用时，调用方必须持有该 Channel 的 ChannelHandle
     virtual void SendMassage(const std::string_view& massage) = 0;
 
     // 子类如果重写，最好在函数的最后手动调用该Close方法
     // 否则真正的关闭将在析构时发生
     virtual void Close();
 
+    // 暂停/恢复读取，暂停期间对端的数据留在内核缓冲区中，由 TCP 流控限速
+    // 只能在所属 EventLoop 线程中调用，不支持暂停的 Channel 忽略
+    virtual void PauseRead() {}
+    virtual void ResumeRead() {}
+
     int fd() const noexcept { return fd_; }
     EventLoop& loop() const noexcept { return loop_; }
 
+    // 对端地址，没有对端的 Channel（例如监听 socket）为 0.0.0.0:0
+    sockaddr_in peerAddr() const noexcept;
+
+    // 已经关闭或从 EventLoop 中移除，之后不会再收到消息
+    bool isClosed() const noexcept { return closed_ || fd_ == -1; }
+
 protected:
-    EventLoop& loop_;
+    void setPeerAddr(const sockaddr_in& addr) noexcept;
 
 private:
+    friend class ChannelHandle;
+
+    // 成员顺序经过安排，以填满基类之后的空隙，Channel 保持 40 字节
     int fd_{-1};  // -1 代表不合法
+
+protected:
+    EventLoop& loop_;
+
+private:
+    // 所有 ChannelHandle 共享一个本地引用，见 ChannelHandle
+    std::atomic_uint32_t remote_refs_{0};
+    // 网络字节序
+    in_addr_t peer_ip_{0};
+    in_port_t peer_port_{0};
+
+protected:
+    bool closed_{false};
+};
+
+// 可在任意线程复制、销毁的 Channel 句柄，用于少数需要跨线程持有连接的场景
+// 第一个句柄创建时增加一次本地引用，最后一个句柄销毁时将释放投递回所属 EventLoop，
+// 因此每个连接只有句柄的增减是原子操作，事件处理路径上没有原子操作
+class ChannelHandle {
+public:
+    ChannelHandle() noexcept = default;
+    // 只能在 channel 所属的 EventLoop 线程中调用
+    explicit ChannelHandle(const ChannelPtr& channel);
+    ChannelHandle(const ChannelHandle& other) noexcept;
+    ChannelHandle(ChannelHandle&& other) noexcept
+        : channel_(std::exchange(other.channel_, nullptr)) {}
+    ChannelHandle& operator=(ChannelHandle other) noexcept {
+        std::swap(channel_, other.channel_);
+        return *this;
+    }
+    ~ChannelHandle() { reset(); }
+
+    void reset() noexcept;
+
+    explicit operator bool() const noexcept { return channel_ != nullptr; }
+
+    // 只能在所属 EventLoop 线程中调用
+    ChannelPtr get() const noexcept { return ChannelPtr(channel_); }
+
+    // 以下方法可在任意线程调用
+    EventLoop& loop() const noexcept { return channel_->loop(); }
+    int fd() const noexcept { return channel_->fd(); }
+    // 在所属 EventLoop 线程中执行 func，执行期间 Channel 保持有效
+    void Post(std::function<void(const ChannelPtr&)> func) const;
+
+    // 为一个已被其它句柄持有的 channel 增加一个句柄，用于跨线程调用的内部实现
+    static ChannelHandle Retain(Channel* channel) noexcept;
+
+private:
+    Channel* channel_{nullptr};
 };
 
 }  // namespace skyline::core
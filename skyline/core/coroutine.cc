@@ -0,0 +1,181 @@
+#include "coroutine.h"
+
+#include <fcntl.h>
+
+#include <cstring>
+
+#include "utils.h"
+
+namespace skyline::core {
+
+namespace detail {
+
+void TaskPromiseBase::DetachedDone() const noexcept {
+    if (!exception_) return;
+    try {
+        std::rethrow_exception(exception_);
+    } catch (const std::exception& e) {
+        SYSTEM_LOG_ERROR << "detached task exit with exception: " << e.what();
+    } catch (const char* e) {
+        SYSTEM_LOG_ERROR << "detached task exit with exception: " << e;
+    } catch (...) {
+        SYSTEM_LOG_ERROR << "detached task exit with unknown exception";
+    }
+}
+
+}  // namespace detail
+
+void Spawn(Task<void> task) {
+    auto h = task.Release();
+    if (!h) return;
+    h.promise().setDetached();
+    h.resume();
+}
+
+// ---------------------------- AsyncSocket ----------------------------
+
+RefPtr<AsyncSocket> AsyncSocket::Create(EventLoop& loop, int fd) {
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+        SYSTEM_LOG_ERROR << "set nonblock fail: [" << fd << "] "
+                         << strerror(errno);
+        ::close(fd);
+        return nullptr;
+    }
+    auto sock = MakeRef<AsyncSocket>(loop, fd);
+    loop.AddSocketContext(sock);
+    return sock;
+}
+
+Task<RefPtr<AsyncSocket>> AsyncSocket::Connect(EventLoop& loop,
+                                               sockaddr_in addr) {
+    co_await ResumeOn(loop);
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        SYSTEM_LOG_ERROR << "socket create fail: " << strerror(errno);
+        co_return nullptr;
+    }
+    auto sock = Create(loop, fd);
+    if (!sock) co_return nullptr;
+    if (::connect(fd, (sockaddr*)&addr, sizeof addr) == -1) {
+        if (errno != EINPROGRESS) {
+            SYSTEM_LOG_ERROR << "connect fail: [" << fd << "] "
+                             << strerror(errno);
+            sock->Close();
+            co_return nullptr;
+        }
+        int err = 0;
+        socklen_t len = sizeof err;
+        if (!co_await sock->Writable() ||
+            ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 ||
+            err != 0) {
+            SYSTEM_LOG_ERROR << "connect fail: [" << fd << "] "
+                             << strerror(err ? err : errno);
+            sock->Close();
+            co_return nullptr;
+        }
+    }
+    co_return sock;
+}
+
+AsyncSocket::AsyncSocket(EventLoop& loop, int fd)
+    : SocketContext(loop, fd, EPOLLIN | EPOLLPRI | EPOLLRDHUP | EPOLLET) {}
+
+Task<ssize_t> AsyncSocket::Read(char* buf, size_t len) {
+    while (!closed_) {
+        auto n = ::read(fd(), buf, len);
+        if (n >= 0) co_return n;
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) co_return -1;
+        co_await Readable();
+    }
+    co_return -1;
+}
+
+Task<ssize_t> AsyncSocket::Write(std::string_view data) {
+    size_t written = 0;
+    while (!closed_ && written < data.size()) {
+        auto n = ::write(fd(), data.data() + written, data.size() - written);
+        if (n >= 0) {
+            written += n;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) co_return -1;
+        co_await Writable();
+    }
+    co_return closed_ ? -1 : static_cast<ssize_t>(written);
+}
+
+bool AsyncSocket::HandleReadEvent() {
+    if (auto h = std::exchange(reader_, {})) h.resume();
+    return true;
+}
+
+bool AsyncSocket::HandleWriteEvent() {
+    if (auto h = std::exchange(writer_, {})) h.resume();
+    return true;
+}
+
+void AsyncSocket::HandleErrorEvent() {
+    closed_ = true;
+    WakeAll();
+}
+
+// 每条消息各自启动一个写任务时，等待可写的任务会被后来者覆盖而永远不再恢复，
+// 部分写出的消息之间也会交错，因此只追加数据，由一个任务负责写出
+void AsyncSocket::SendMassage(const std::string_view& massage) {
+    if (closed_) return;
+    if (!write_buffer_.WriteAll(massage)) {
+        SYSTEM_LOG_WARN << "write buffer overflow, close socket: [" << fd()
+                        << "]";
+        Close();
+        return;
+    }
+    if (flushing_) return;
+    flushing_ = true;
+    Spawn(Flush(RefPtr<AsyncSocket>(this)));
+}
+
+Task<void> AsyncSocket::Flush(RefPtr<AsyncSocket> self) {
+    auto& buf = self->write_buffer_;
+    while (!self->closed_ && buf.size() > 0) {
+        auto n = ::write(self->fd(), buf.data(), buf.size());
+        if (n >= 0) {
+            buf.Retrieve(n);
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            self->Close();
+            break;
+        }
+        co_await self->Writable();
+    }
+    // 关闭后剩余的数据无法再写出
+    buf.Retrieve(buf.size());
+    self->flushing_ = false;
+}
+
+void AsyncSocket::Close() {
+    if (closed_) return;
+    closed_ = true;
+    loop_.RemoveSocketContext(fd());
+    WakeAll();
+}
+
+void AsyncSocket::WaitRead(std::coroutine_handle<> h) { reader_ = h; }
+
+void AsyncSocket::WaitWrite(std::coroutine_handle<> h) {
+    writer_ = h;
+    if (!(events & EPOLLOUT)) {
+        events |= EPOLLOUT;
+        loop_.UpdateSocketContext(fd(), events);
+    }
+}
+
+void AsyncSocket::WakeAll() {
+    if (auto h = std::exchange(reader_, {})) h.resume();
+    if (auto h = std::exchange(writer_, {})) h.resume();
+}
+
+}  // namespace skyline::core
@@ -0,0 +1,262 @@
+/**
+ * 该文件提供基于 C++20 协程的异步编程支持：包括
+ *      Task<T>：惰性启动的协程任务，可以被 co_await，也可以通过 Spawn 独立运行
+ *      Sleep：等待 EventLoop 定时器超时
+ *      ResumeOn：切换到指定 EventLoop 所在线程继续执行
+ *      AsyncSocket：可等待读写就绪的非阻塞 socket
+ *
+ * example:
+ *      core::Task<int> Handler(core::EventLoop& loop) {
+ *          co_await core::Sleep(loop, 100);
+ *          co_return 0;
+ *      }
+ *
+ * tip:
+ * 协程恢复时只捕获 coroutine_handle，放入 std::function 时不会额外分配内存
+ * 所有 awaitable 都在被等待的 EventLoop 线程中恢复协程
+ **/
+
+#pragma once
+
+#include <netinet/in.h>
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "event_loop.h"
+#include "socket_context.h"
+
+namespace skyline::core {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+class TaskPromiseBase {
+public:
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<Promise> h) noexcept {
+            auto& promise = h.promise();
+            if (promise.continuation_) return promise.continuation_;
+            if (promise.detached_) {
+                promise.DetachedDone();
+                h.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept {
+        exception_ = std::current_exception();
+    }
+
+    void setContinuation(std::coroutine_handle<> h) noexcept {
+        continuation_ = h;
+    }
+    void setDetached() noexcept { detached_ = true; }
+
+protected:
+    void RethrowIfException() const {
+        if (exception_) std::rethrow_exception(exception_);
+    }
+
+private:
+    // 独立运行的协程结束时调用，记录未被处理的异常
+    void DetachedDone() const noexcept;
+
+private:
+    std::coroutine_handle<> continuation_;
+    std::exception_ptr exception_;
+    bool detached_{false};
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+    Task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& value) {
+        value_.emplace(std::forward<U>(value));
+    }
+
+    T result() {
+        RethrowIfException();
+        return std::move(*value_);
+    }
+
+private:
+    std::optional<T> value_;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void result() const { RethrowIfException(); }
+};
+
+}  // namespace detail
+
+// 惰性启动的协程任务，只有被 co_await 或 Spawn 时才开始执行
+// 被等待的任务结束后通过对称转移直接恢复等待者，不经过事件循环
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    Task() noexcept = default;
+    explicit Task(handle_type h) noexcept : handle_(h) {}
+    Task(const Task&) = delete;
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task other) noexcept {
+        std::swap(handle_, other.handle_);
+        return *this;
+    }
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            handle_type h;
+
+            bool await_ready() const noexcept { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<> caller) noexcept {
+                h.promise().setContinuation(caller);
+                return h;
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+        return Awaiter{handle_};
+    }
+
+    // 放弃所有权，协程结束时自行销毁
+    handle_type Release() noexcept { return std::exchange(handle_, {}); }
+
+private:
+    handle_type handle_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(
+        std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}  // namespace detail
+
+// 在当前线程中立即启动一个独立运行的任务，任务结束后自动销毁
+void Spawn(Task<void> task);
+
+// 等待 msec 毫秒，在 loop 线程中恢复
+inline auto Sleep(EventLoop& loop, std::time_t msec) noexcept {
+    struct Awaiter {
+        EventLoop& loop;
+        std::time_t msec;
+
+        bool await_ready() const noexcept { return msec <= 0; }
+        void await_suspend(std::coroutine_handle<> h) {
+            loop.AddTimer(msec, [h](auto) { h.resume(); });
+        }
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{loop, msec};
+}
+
+// 切换到 loop 所在线程继续执行，已在该线程中时不挂起
+inline auto ResumeOn(EventLoop& loop) noexcept {
+    struct Awaiter {
+        EventLoop& loop;
+
+        bool await_ready() const noexcept { return loop.isInLoopThread(); }
+        void await_suspend(std::coroutine_handle<> h) {
+            loop.RunInLoop([h]() { h.resume(); });
+        }
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{loop};
+}
+
+// 可等待读写就绪的非阻塞 socket，使用边缘触发
+// 必须通过 RefPtr 管理，且只能在所属 EventLoop 线程中使用
+// 同一时刻最多允许一个读等待者和一个写等待者
+class AsyncSocket : public detail::SocketContext {
+public:
+    // fd 应该是一个已连接的 socket，将被设置为非阻塞
+    // 必须在 loop 线程中调用
+    static RefPtr<AsyncSocket> Create(EventLoop& loop, int fd);
+
+    // 异步连接 addr，失败时返回空指针
+    static Task<RefPtr<AsyncSocket>> Connect(EventLoop& loop,
+                                             sockaddr_in addr);
+
+    AsyncSocket(EventLoop& loop, int fd);
+
+    auto Readable() noexcept { return ReadyAwaiter{*this, false}; }
+    auto Writable() noexcept { return ReadyAwaiter{*this, true}; }
+
+    // 读取至多 len 字节，返回 0 代表对端关闭，-1 代表出错
+    Task<ssize_t> Read(char* buf, size_t len);
+    // 写出全部数据，返回写出的字节数，-1 代表出错
+    // 与 SendMassage 同时使用时两者的数据可能交错
+    Task<ssize_t> Write(std::string_view data);
+
+    bool HandleReadEvent() override;
+    bool HandleWriteEvent() override;
+    void HandleErrorEvent() override;
+    bool NeedWrite() override { return static_cast<bool>(writer_); }
+
+    // 追加到发送缓冲区，由唯一的发送任务按序写出，出错时关闭 socket
+    void SendMassage(const std::string_view& massage) override;
+    void Close() override;
+
+private:
+    struct ReadyAwaiter {
+        AsyncSocket& sock;
+        bool write;
+
+        bool await_ready() const noexcept { return sock.closed_; }
+        void await_suspend(std::coroutine_handle<> h) {
+            write ? sock.WaitWrite(h) : sock.WaitRead(h);
+        }
+        // 返回 socket 是否仍然可用
+        bool await_resume() const noexcept { return !sock.closed_; }
+    };
+
+    void WaitRead(std::coroutine_handle<> h);
+    void WaitWrite(std::coroutine_handle<> h);
+    // 写出发送缓冲区中的数据，直到写完或出错，同一时刻只有一个在运行
+    static Task<void> Flush(RefPtr<AsyncSocket> self);
+    // 出错或关闭时唤醒所有等待者
+    void WakeAll();
+
+private:
+    std::coroutine_handle<> reader_;
+    std::coroutine_handle<> writer_;
+    bool flushing_{false};
+};
+
+}  // namespace skyline::core
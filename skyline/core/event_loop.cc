@@ -1,7 +1,11 @@
 #include "event_loop.h"
 
 #include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 
+#include <bit>
+#include <chrono>
 #include <cstring>
 
 #include "socket_context.h"
@@ -9,12 +13,29 @@
 
 static constexpr int kMaxEvents = 1000;
 
+// glibc 头文件尚未包含时，按内核 uapi 定义（Linux 6.9+）
+#ifndef EPIOCSPARAMS
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t __pad;
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
+static uint64_t nowUsec() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(
+               steady_clock::now().time_since_epoch())
+        .count();
+}
+
 namespace skyline::core {
 
 EventLoop::EventLoop()
-    : epfd_(epoll_create1(0)),
-      wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
-      events_(new ::epoll_event[kMaxEvents]()) {
+    : epfd_(epoll_create1(EPOLL_CLOEXEC)),
+      wakeup_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
     if (epfd_ == -1) {
         SYSTEM_LOG_FATAL << "epoll create fail: " << strerror(errno);
         throw "epoll create fail";
@@ -30,15 +51,39 @@ EventLoop::EventLoop()
     }
 }
 
+EventLoop::~EventLoop() = default;
+
 void EventLoop::Loop() {
     tid_ = std::this_thread::get_id();
+    if (!events_) events_ = std::make_unique<::epoll_event[]>(kMaxEvents);
+    bool busy = false;
+    const bool spin = busy_poll_.spin_usec > 0;
+    uint64_t last_active_us = 0;
     while (!quit_) {
-        int nfds = epoll_wait(epfd_, events_, kMaxEvents, timer_.timeToSleep());
+        std::time_t timeout = busy ? 0 : timer_.timeToSleep();
+        const uint64_t wait_us = nowUsec();
+        bool spinning = false;
+        if (spin) {
+            spinning = timeout != 0 &&
+                       wait_us - last_active_us < busy_poll_.spin_usec;
+            if (spinning) timeout = 0;
+        }
+        int nfds = epoll_wait(epfd_, events_.get(), kMaxEvents, timeout);
         if (nfds == -1) {
             if (errno == EINTR) continue;
             SYSTEM_LOG_FATAL << "epoll wait error: " << strerror(errno);
             break;
         }
+        const auto start_us = nowUsec();
+        // 等待时间超过平均处理耗时说明 EventLoop 曾经空闲，已不再过载，
+        // 立即从零开始统计，避免空闲前的耗时影响本轮的过载判断
+        auto lag = loop_lag_us_.load(std::memory_order_relaxed);
+        if (start_us - wait_us > lag) {
+            lag = 0;
+            loop_lag_us_.store(0, std::memory_order_relaxed);
+        }
+        if (spin) RecordPoll(spinning, timeout != 0, nfds, wait_us, start_us);
+        if (spin && (nfds > 0 || busy)) last_active_us = start_us;
         for (int i = 0; i < nfds; ++i) {
             const ::epoll_event &cur_ev = events_[i];
             if (cur_ev.data.fd == wakeup_fd_) {
@@ -52,6 +97,7 @@ void EventLoop::Loop() {
                 if (errno == EINTR) continue;
                 SYSTEM_LOG_ERROR << "epoll error event: " << cur_ev.data.fd
                                  << " " << strerror(errno);
+                cur_conn->HandleErrorEvent();
                 RemoveSocketContext(cur_ev.data.fd);
                 continue;
             }
@@ -73,6 +119,60 @@ void EventLoop::Loop() {
         }
         DoPendingFuncs();
         timer_.checkTimer();
+        busy = iteration_cb_ && iteration_cb_();
+        // 只在本线程写，使用 1/8 权重的指数滑动平均
+        loop_lag_us_.store(lag - lag / 8 + (nowUsec() - start_us) / 8,
+                           std::memory_order_relaxed);
+    }
+}
+
+void EventLoop::setBusyPoll(const BusyPollOptions &options) {
+    busy_poll_ = options;
+    if (options.epoll_busy_poll_usec == 0) return;
+    epoll_params params{
+        .busy_poll_usecs = options.epoll_busy_poll_usec,
+        .busy_poll_budget = options.epoll_busy_poll_budget,
+        .prefer_busy_poll = options.prefer_busy_poll,
+    };
+    if (::ioctl(epfd_, EPIOCSPARAMS, &params) == -1) {
+        SYSTEM_LOG_WARN << "set epoll busy poll params fail: "
+                        << strerror(errno);
+    }
+}
+
+BusyPollStats EventLoop::busyPollStats() const noexcept {
+    BusyPollStats stats{
+        .spin_polls = spin_polls_,
+        .spin_hits = spin_hits_,
+        .spin_idle_usec = spin_idle_us_,
+        .blocking_waits = blocking_waits_,
+    };
+    for (size_t i = 0; i < stats.wakeup_usec_hist.size(); ++i) {
+        stats.wakeup_usec_hist[i] = wakeup_hist_[i];
+    }
+    return stats;
+}
+
+void EventLoop::RecordPoll(bool spinning, bool blocking, int nfds,
+                           uint64_t wait_us, uint64_t now_us) {
+    constexpr auto relaxed = std::memory_order_relaxed;
+    if (spinning) {
+        spin_polls_.store(spin_polls_.load(relaxed) + 1, relaxed);
+        if (nfds > 0) {
+            spin_hits_.store(spin_hits_.load(relaxed) + 1, relaxed);
+        } else {
+            spin_idle_us_.store(spin_idle_us_.load(relaxed) + now_us - wait_us,
+                                relaxed);
+        }
+    } else if (blocking) {
+        blocking_waits_.store(blocking_waits_.load(relaxed) + 1, relaxed);
+        if (nfds > 0) {
+            auto waited = std::max<uint64_t>(now_us - wait_us, 1);
+            auto bucket = std::min<size_t>(std::bit_width(waited) - 1,
+                                           BusyPollStats::kBuckets - 1);
+            wakeup_hist_[bucket].store(wakeup_hist_[bucket].load(relaxed) + 1,
+                                       relaxed);
+        }
     }
 }
 
@@ -85,22 +185,44 @@ void EventLoop::Stop() {
 void EventLoop::Wakeup() { ::eventfd_write(wakeup_fd_, 1); }
 
 // 为确保线程安全，fd的添加应该放在loop中执行
-void EventLoop::AddSocketContext(std::shared_ptr<detail::SocketContext> ctx) {
-    RunInLoop([this, ctx = std::move(ctx)]() {
-        if (!ctx || ctx->fd() < 0 || socket_ctxs_[ctx->fd()]) return;
-        epoll_event ev{
-            .events = ctx->events,
-            .data = {.fd = ctx->fd()},
-        };
-        socket_ctxs_[ctx->fd()] = ctx;
-        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, ctx->fd(), &ev) == -1) {
-            socket_ctxs_[ctx->fd()].reset();
-            SYSTEM_LOG_ERROR << "epoll add fail: [" << ctx->fd() << "] "
-                             << strerror(errno);
-            return;
-        }
-        SYSTEM_LOG_DEBUG << "[" << ctx->fd() << "] added into epoll";
-    });
+// 计数在投递前增加，使负载均衡能立即看到新分配的连接
+void EventLoop::AddSocketContext(RefPtr<detail::SocketContext> ctx) {
+    ++conn_count_;
+    RunInLoop([this, ctx = std::move(ctx)]() { AddInLoop(ctx); });
+}
+
+void EventLoop::CreateSocketContext(
+    std::function<RefPtr<detail::SocketContext>()> create) {
+    ++conn_count_;
+    RunInLoop([this, create = std::move(create)]() { AddInLoop(create()); });
+}
+
+void EventLoop::AddInLoop(const RefPtr<detail::SocketContext> &ctx) {
+    if (!ctx || ctx->fd() < 0 || socket_ctxs_[ctx->fd()]) {
+        --conn_count_;
+        return;
+    }
+    epoll_event ev{
+        .events = ctx->events,
+        .data = {.fd = ctx->fd()},
+    };
+    socket_ctxs_[ctx->fd()] = ctx;
+    if (busy_poll_.socket_busy_poll_usec > 0 &&
+        ::setsockopt(ctx->fd(), SOL_SOCKET, SO_BUSY_POLL,
+                     &busy_poll_.socket_busy_poll_usec,
+                     sizeof busy_poll_.socket_busy_poll_usec) == -1) {
+        SYSTEM_LOG_DEBUG << "set busy poll fail: [" << ctx->fd() << "] "
+                         << strerror(errno);
+    }
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, ctx->fd(), &ev) == -1) {
+        --conn_count_;
+        socket_ctxs_[ctx->fd()].reset();
+        SYSTEM_LOG_ERROR << "epoll add fail: [" << ctx->fd() << "] "
+                         << strerror(errno);
+        return;
+    }
+    SYSTEM_LOG_DEBUG << "[" << ctx->fd() << "] added into epoll";
+    ctx->HandleAddedEvent();
 }
 
 void EventLoop::UpdateSocketContext(int fd, uint32_t events) {
@@ -121,8 +243,10 @@ void EventLoop::RemoveSocketContext(int fd) {
     RunInLoop([this, fd]() {
         if (fd >= 0 && socket_ctxs_[fd]) {
             epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, NULL);
-            socket_ctxs_[fd].reset();
+            auto ctx = std::move(socket_ctxs_[fd]);
+            --conn_count_;
             SYSTEM_LOG_DEBUG << "[" << fd << "] del from epoll";
+            ctx->HandleRemovedEvent();
         }
     });
 }
@@ -135,7 +259,7 @@ Timer::timer_id_t EventLoop::AddTimer(std::time_t msec,
 void EventLoop::RemoveTimer(Timer::timer_id_t id) { timer_.delTimer(id); }
 
 void EventLoop::RunInLoop(std::function<void()> func) {
-    if (tid_ == std::this_thread::get_id()) {
+    if (isInLoopThread()) {
         func();
     } else {
         std::lock_guard lock(pending_mtx_);
@@ -2,10 +2,13 @@
 
 #include <sys/epoll.h>
 
+#include <array>
 #include <map>
 #include <memory>
 #include <thread>
 
+#include "memory_pool.h"
+#include "ref_counted.h"
 #include "timer.h"
 
 namespace skyline::core {
@@ -16,12 +19,39 @@ class SocketContext;
 
 }
 
+// 忙轮询配置，用于对延迟敏感的 EventLoop，默认全部关闭
+struct BusyPollOptions {
+    // 有事件或任务后，在该时间窗口内使用 epoll_wait(timeout=0) 自旋
+    // 窗口内没有新的活动才退回阻塞等待；0 为关闭
+    uint32_t spin_usec{0};
+    // 为加入该 EventLoop 的 socket 设置 SO_BUSY_POLL（超过系统配置时需要权限）
+    int socket_busy_poll_usec{0};
+    // 通过 EPIOCSPARAMS 设置 epoll 的忙轮询参数（需要 Linux 6.9+）
+    uint32_t epoll_busy_poll_usec{0};
+    uint16_t epoll_busy_poll_budget{0};
+    bool prefer_busy_poll{false};
+};
+
+// 忙轮询统计，用于调整自旋窗口
+struct BusyPollStats {
+    static constexpr size_t kBuckets = 16;
+
+    uint64_t spin_polls{0};      // 自旋期间的非阻塞 epoll_wait 次数
+    uint64_t spin_hits{0};       // 其中拿到事件的次数
+    uint64_t spin_idle_usec{0};  // 空转消耗的时间，近似为自旋浪费的 CPU 时间
+    uint64_t blocking_waits{0};  // 阻塞等待次数
+    // 阻塞等待后被事件唤醒的等待时长分布，第 i 个桶为 [2^i, 2^(i+1)) 微秒
+    // 若大量唤醒落在略大于自旋窗口的桶中，说明窗口可以适当调大
+    std::array<uint64_t, kBuckets> wakeup_usec_hist{};
+};
+
 // EventLoop 管理一个 epoll
 // 设计用于在一个线程内使用 Loop 方法循环等待事件
 // 同时提供线程唤醒、定时器管理的功能
 class EventLoop {
 public:
     EventLoop();
+    ~EventLoop();
 
     // Wait events then handle events.
     void Loop();
@@ -31,7 +61,12 @@ public:
     // wakeup `epoll_wait` to break loop.
     void Wakeup();
 
-    void AddSocketContext(std::shared_ptr<detail::SocketContext> ctx);
+    // ctx 的所有权转交给 EventLoop，调用方不应在其它线程中保留 ctx 的引用
+    void AddSocketContext(RefPtr<detail::SocketContext> ctx);
+    // 在 Loop 线程中调用 create 创建并添加，用于从本线程的内存池中分配对象
+    // 与 AddSocketContext 一样，连接计数在调用时立即增加
+    void CreateSocketContext(
+        std::function<RefPtr<detail::SocketContext>()> create);
 
     void UpdateSocketContext(int fd, uint32_t events);
     void RemoveSocketContext(int fd);
@@ -41,27 +76,75 @@ public:
 
     void RemoveTimer(Timer::timer_id_t id);
 
+    // 若当前就在 Loop 所在线程则直接执行，否则投递到 Loop 线程中执行
     void RunInLoop(std::function<void()> func);
 
+    // 每次事件处理完毕后调用，返回 true 表示仍有待执行的工作
+    // 此时下一次 epoll_wait 不会阻塞
+    void setIterationCallback(std::function<bool()> cb) {
+        iteration_cb_ = std::move(cb);
+    }
+
+    // 开启或调整忙轮询，应在 Loop 开始前调用
+    void setBusyPoll(const BusyPollOptions& options);
+    // 可在任意线程读取，各计数之间不保证一致
+    BusyPollStats busyPollStats() const noexcept;
+
     bool isQuit() { return quit_; }
+    bool isInLoopThread() const {
+        return tid_.load(std::memory_order_relaxed) ==
+               std::this_thread::get_id();
+    }
+
+    // 本线程的对象与缓冲区内存池，只能在 Loop 线程中使用
+    SlabAllocator& slab() noexcept { return slab_; }
+    BufferPool& bufferPool() noexcept { return buffer_pool_; }
+
+    // 负载统计，可在任意线程读取
+    // 当前管理（包括正在添加）的 socket 数
+    size_t connectionCount() const noexcept { return conn_count_; }
+    // 每轮事件处理耗时（不含等待）的滑动平均值，单位微秒
+    // 阻塞等待的时间超过该值时说明曾经空闲，从零开始重新统计
+    uint64_t loopLagUsec() const noexcept { return loop_lag_us_; }
 
 private:
+    void AddInLoop(const RefPtr<detail::SocketContext>& ctx);
     void DoPendingFuncs();
+    void RecordPoll(bool spinning, bool blocking, int nfds, uint64_t wait_us,
+                    uint64_t now_us);
 
 private:
+    // 内存池必须最先构造、最后析构，其它成员中可能仍持有从池中分配的对象
+    SlabAllocator slab_;
+    BufferPool buffer_pool_;
+
     int epfd_{-1};
     std::atomic_bool quit_{false};
     int wakeup_fd_{-1};
-    ::epoll_event* events_{nullptr};
+    // 在 Loop 线程中第一次运行时才分配，使内存位于该线程所在的 NUMA 节点
+    std::unique_ptr<::epoll_event[]> events_;
     Timer timer_;
+    std::function<bool()> iteration_cb_;
 
     std::mutex pending_mtx_;
     std::vector<std::function<void()>> pending_funcs_;
 
-    std::thread::id tid_;  // 用于记录 Loop 函数运行所在的线程 id
+    // 用于记录 Loop 函数运行所在的线程 id，其它线程会读取
+    std::atomic<std::thread::id> tid_;
+
+    std::atomic_size_t conn_count_{0};
+    std::atomic_uint64_t loop_lag_us_{0};
+
+    BusyPollOptions busy_poll_;
+    // 只在 Loop 线程中写
+    std::atomic_uint64_t spin_polls_{0};
+    std::atomic_uint64_t spin_hits_{0};
+    std::atomic_uint64_t spin_idle_us_{0};
+    std::atomic_uint64_t blocking_waits_{0};
+    std::array<std::atomic_uint64_t, BusyPollStats::kBuckets> wakeup_hist_{};
 
     // fd -> ctx 一个文件描述符对应一个上下文
-    std::map<int, std::shared_ptr<detail::SocketContext>> socket_ctxs_;
+    std::map<int, RefPtr<detail::SocketContext>> socket_ctxs_;
 };
 
 }  // namespace skyline::core
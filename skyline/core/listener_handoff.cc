@@ -0,0 +1,157 @@
+#include "listener_handoff.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "utils.h"
+
+// 一次最多交接的监听 socket 数
+static constexpr size_t kMaxFds = 16;
+// 新进程等待旧进程发送的最长时间
+static constexpr time_t kReceiveTimeoutSec = 5;
+
+namespace skyline::core {
+
+static bool makeAddr(const std::string& path, sockaddr_un& addr) {
+    addr = {.sun_family = AF_UNIX};
+    if (path.empty() || path.size() >= sizeof addr.sun_path) {
+        SYSTEM_LOG_ERROR << "invalid handoff path: " << path;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    return true;
+}
+
+ListenerHandoff::ListenerHandoff(std::string path) : path_(std::move(path)) {
+    sockaddr_un addr;
+    if (!makeAddr(path_, addr)) return;
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ == -1) {
+        SYSTEM_LOG_ERROR << "handoff socket create fail: " << strerror(errno);
+        return;
+    }
+    // 清理上次遗留的 socket 文件
+    ::unlink(path_.c_str());
+    if (::bind(fd_, (sockaddr*)&addr, sizeof addr) == -1 ||
+        ::listen(fd_, 1) == -1) {
+        SYSTEM_LOG_ERROR << "handoff listen fail: " << path_ << " "
+                         << strerror(errno);
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+ListenerHandoff::~ListenerHandoff() {
+    if (fd_ != -1) {
+        ::close(fd_);
+        ::unlink(path_.c_str());
+    }
+}
+
+bool ListenerHandoff::Send(const std::vector<int>& fds,
+                           std::time_t timeout_ms) {
+    if (fd_ == -1 || fds.empty() || fds.size() > kMaxFds) return false;
+    ::pollfd pfd{.fd = fd_, .events = POLLIN};
+    int ready;
+    do {
+        ready = ::poll(&pfd, 1, static_cast<int>(timeout_ms));
+    } while (ready == -1 && errno == EINTR);
+    if (ready <= 0) {
+        SYSTEM_LOG_ERROR << "handoff wait fail: " << path_ << " "
+                         << (ready == 0 ? "timeout" : strerror(errno));
+        return false;
+    }
+    int conn = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (conn == -1) {
+        SYSTEM_LOG_ERROR << "handoff accept fail: " << strerror(errno);
+        return false;
+    }
+    // 数据部分为 fd 数量，控制消息中携带 fd 本身
+    char cnt = static_cast<char>(fds.size());
+    ::iovec iov{.iov_base = &cnt, .iov_len = 1};
+    alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxFds)]{};
+    ::msghdr msg{
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = CMSG_SPACE(sizeof(int) * fds.size()),
+    };
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    ssize_t n;
+    do {
+        n = ::sendmsg(conn, &msg, MSG_NOSIGNAL);
+    } while (n == -1 && errno == EINTR);
+    ::close(conn);
+    if (n != 1) {
+        SYSTEM_LOG_ERROR << "handoff send fail: " << strerror(errno);
+        return false;
+    }
+    SYSTEM_LOG_INFO << "handoff " << fds.size() << " listener(s) via "
+                    << path_;
+    return true;
+}
+
+std::vector<int> ListenerHandoff::Receive(const std::string& path) {
+    std::vector<int> fds;
+    sockaddr_un addr;
+    if (!makeAddr(path, addr)) return fds;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        SYSTEM_LOG_ERROR << "handoff socket create fail: " << strerror(errno);
+        return fds;
+    }
+    // 没有旧进程（文件不存在或无人监听）是首次启动的正常情况
+    if (::connect(fd, (sockaddr*)&addr, sizeof addr) == -1) {
+        SYSTEM_LOG_DEBUG << "no listener to take over: " << path << " "
+                         << strerror(errno);
+        ::close(fd);
+        return fds;
+    }
+    ::timeval tv{.tv_sec = kReceiveTimeoutSec};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    char cnt = 0;
+    ::iovec iov{.iov_base = &cnt, .iov_len = 1};
+    alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxFds)]{};
+    ::msghdr msg{
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof control,
+    };
+    ssize_t n;
+    do {
+        n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+    ::close(fd);
+    if (n != 1) {
+        SYSTEM_LOG_ERROR << "handoff receive fail: " << path << " "
+                         << (n == 0 ? "closed" : strerror(errno));
+        return fds;
+    }
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        auto begin = fds.size();
+        fds.resize(begin + num);
+        std::memcpy(fds.data() + begin, CMSG_DATA(cmsg), sizeof(int) * num);
+    }
+    if (msg.msg_flags & MSG_CTRUNC) {
+        SYSTEM_LOG_WARN << "handoff control message truncated";
+    }
+    SYSTEM_LOG_INFO << "took over " << fds.size() << " listener(s) via "
+                    << path;
+    return fds;
+}
+
+}  // namespace skyline::core
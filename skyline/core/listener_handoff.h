@@ -0,0 +1,32 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace skyline::core {
+
+// 通过 Unix 域 socket（SCM_RIGHTS）将监听 socket 交给新启动的进程
+// 用于不停机重启：新进程直接使用同一个监听 socket，端口不会出现关闭的窗口
+//
+// 旧进程：先构造 ListenerHandoff（绑定 path），再启动新进程并调用 Send
+// 新进程：启动时调用 Receive，返回空代表没有可接管的旧进程，需要自行监听
+class ListenerHandoff {
+public:
+    explicit ListenerHandoff(std::string path);
+    ListenerHandoff(const ListenerHandoff&) = delete;
+    ~ListenerHandoff();
+
+    // 等待新进程连接并发送 fds，超时或失败时返回 false
+    // 会阻塞调用线程，不要在 EventLoop 线程中调用
+    bool Send(const std::vector<int>& fds, std::time_t timeout_ms);
+
+    // 连接旧进程并接收监听 socket，收到的 fd 均设置了 close-on-exec
+    static std::vector<int> Receive(const std::string& path);
+
+private:
+    std::string path_;
+    int fd_{-1};
+};
+
+}  // namespace skyline::core
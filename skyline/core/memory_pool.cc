@@ -0,0 +1,75 @@
+#include "memory_pool.h"
+
+namespace skyline::core {
+
+void* SlabAllocator::Allocate(size_t size) {
+    if (size == 0 || size > kMaxSize) return ::operator new(size);
+    auto cls = ClassOf(size);
+    if (free_[cls] == nullptr) {
+        // 一次申请一整块，切分后挂到空闲链表上
+        const auto obj_size = (cls + 1) * kAlign;
+        std::unique_ptr<std::byte[], ChunkDeleter> chunk(
+            static_cast<std::byte*>(::operator new[](
+                obj_size * kObjectsPerChunk, std::align_val_t(kAlign))));
+        for (size_t i = kObjectsPerChunk; i-- > 0;) {
+            auto node = reinterpret_cast<FreeNode*>(chunk.get() + i * obj_size);
+            node->next = free_[cls];
+            free_[cls] = node;
+        }
+        chunks_.push_back(std::move(chunk));
+    }
+    auto node = free_[cls];
+    free_[cls] = node->next;
+    ++in_use_;
+    return node;
+}
+
+void SlabAllocator::Deallocate(void* ptr, size_t size) noexcept {
+    if (ptr == nullptr) return;
+    if (size == 0 || size > kMaxSize) {
+        ::operator delete(ptr);
+        return;
+    }
+    auto cls = ClassOf(size);
+    auto node = static_cast<FreeNode*>(ptr);
+    node->next = free_[cls];
+    free_[cls] = node;
+    --in_use_;
+}
+
+BufferPool::~BufferPool() {
+    for (auto& blocks : cached_) {
+        for (auto block : blocks) delete[] block;
+    }
+}
+
+char* BufferPool::Acquire(size_t size, size_t& cap) {
+    for (size_t i = 0; i < kTiers.size(); ++i) {
+        if (size > kTiers[i]) continue;
+        cap = kTiers[i];
+        borrowed_ += cap;
+        if (cached_[i].empty()) return new char[cap];
+        auto block = cached_[i].back();
+        cached_[i].pop_back();
+        return block;
+    }
+    cap = size;
+    borrowed_ += cap;
+    return new char[cap];
+}
+
+void BufferPool::Release(char* block, size_t cap) noexcept {
+    if (block == nullptr) return;
+    borrowed_ -= cap;
+    for (size_t i = 0; i < kTiers.size(); ++i) {
+        if (cap != kTiers[i]) continue;
+        if (cached_[i].size() * cap < kMaxCachedBytes) {
+            cached_[i].push_back(block);
+            return;
+        }
+        break;
+    }
+    delete[] block;
+}
+
+}  // namespace skyline::core
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace skyline::core {
+
+// 按大小分级的对象内存池，每级维护一个空闲链表，内存按块批量申请
+// 只在所属 EventLoop 线程中使用，无锁；内存直到池析构时才归还系统
+class SlabAllocator {
+public:
+    static constexpr size_t kAlign = 64;
+    static constexpr size_t kMaxSize = 1024;
+
+    SlabAllocator() = default;
+    SlabAllocator(const SlabAllocator&) = delete;
+
+    // 超过 kMaxSize 的请求直接使用 operator new
+    void* Allocate(size_t size);
+    void Deallocate(void* ptr, size_t size) noexcept;
+
+    // 正在使用的对象数
+    size_t inUse() const noexcept { return in_use_; }
+
+private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+    struct ChunkDeleter {
+        void operator()(std::byte* chunk) const noexcept {
+            ::operator delete[](chunk, std::align_val_t(kAlign));
+        }
+    };
+    static constexpr size_t kClasses = kMaxSize / kAlign;
+    static constexpr size_t kObjectsPerChunk = 64;
+
+    static size_t ClassOf(size_t size) noexcept {
+        return (size + kAlign - 1) / kAlign - 1;
+    }
+
+    std::array<FreeNode*, kClasses> free_{};
+    std::vector<std::unique_ptr<std::byte[], ChunkDeleter>> chunks_;
+    size_t in_use_{0};
+};
+
+// 分级缓冲区池，提供 4K/16K/64K 三种大小的内存块
+// 只在所属 EventLoop 线程中使用，每级最多缓存 kMaxCachedBytes 字节
+class BufferPool {
+public:
+    static constexpr std::array<size_t, 3> kTiers{4096, 16384, 65536};
+    static constexpr size_t kMaxCachedBytes = 4 << 20;
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    ~BufferPool();
+
+    // 返回容量不小于 size 的内存块，实际容量写入 cap
+    // 超过最大级别时按需直接申请，释放时也直接归还
+    char* Acquire(size_t size, size_t& cap);
+    void Release(char* block, size_t cap) noexcept;
+
+    // 借出未归还的字节数，用于统计
+    size_t borrowedBytes() const noexcept { return borrowed_; }
+
+private:
+    std::array<std::vector<char*>, kTiers.size()> cached_;
+    size_t borrowed_{0};
+};
+
+}  // namespace skyline::core
@@ -0,0 +1,54 @@
+#include "placement_policy.h"
+
+#include "event_loop.h"
+
+namespace skyline::core {
+
+size_t RoundRobinPolicy::Select(const std::vector<EventLoop>& loops,
+                                const sockaddr_in* peer) {
+    return next_.fetch_add(1, std::memory_order_relaxed) % loops.size();
+}
+
+size_t LeastConnectionsPolicy::Select(const std::vector<EventLoop>& loops,
+                                      const sockaddr_in* peer) {
+    // 从轮询位置开始扫描，避免连接数相同时总是选中第一个
+    const auto n = loops.size();
+    const auto start = RoundRobinPolicy::Select(loops, peer);
+    auto best = start;
+    for (size_t i = 1; i < n; ++i) {
+        auto cur = (start + i) % n;
+        if (loops[cur].connectionCount() < loops[best].connectionCount()) {
+            best = cur;
+        }
+    }
+    return best;
+}
+
+size_t LeastLagPolicy::Select(const std::vector<EventLoop>& loops,
+                              const sockaddr_in* peer) {
+    const auto n = loops.size();
+    const auto start = RoundRobinPolicy::Select(loops, peer);
+    auto best = start;
+    for (size_t i = 1; i < n; ++i) {
+        auto cur = (start + i) % n;
+        auto cur_lag = loops[cur].loopLagUsec();
+        auto best_lag = loops[best].loopLagUsec();
+        if (cur_lag < best_lag ||
+            (cur_lag == best_lag && loops[cur].connectionCount() <
+                                        loops[best].connectionCount())) {
+            best = cur;
+        }
+    }
+    return best;
+}
+
+size_t AddressHashPolicy::Select(const std::vector<EventLoop>& loops,
+                                 const sockaddr_in* peer) {
+    if (peer == nullptr) return RoundRobinPolicy::Select(loops, peer);
+    // Fibonacci 哈希，打散相邻的 IP
+    uint64_t h = static_cast<uint64_t>(peer->sin_addr.s_addr) *
+                 0x9E3779B97F4A7C15ull;
+    return (h >> 32) % loops.size();
+}
+
+}  // namespace skyline::core
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace skyline::core {
+
+class EventLoop;
+
+// 新连接放置策略，决定新连接交给哪一个子反应堆
+// Select 只在主反应堆线程中调用，loops 保证非空
+class PlacementPolicy {
+public:
+    virtual ~PlacementPolicy() = default;
+
+    // peer 为对端地址，未知时为空指针；返回 loops 中的下标
+    virtual size_t Select(const std::vector<EventLoop>& loops,
+                          const sockaddr_in* peer) = 0;
+};
+
+// 轮询
+class RoundRobinPolicy : public PlacementPolicy {
+public:
+    size_t Select(const std::vector<EventLoop>& loops,
+                  const sockaddr_in* peer) override;
+
+private:
+    std::atomic_size_t next_{0};
+};
+
+// 选择当前连接数最少的 EventLoop，连接数相同时轮询
+class LeastConnectionsPolicy : public RoundRobinPolicy {
+public:
+    size_t Select(const std::vector<EventLoop>& loops,
+                  const sockaddr_in* peer) override;
+};
+
+// 选择每轮事件处理耗时最短的 EventLoop，耗时相同时选择连接数少的
+class LeastLagPolicy : public RoundRobinPolicy {
+public:
+    size_t Select(const std::vector<EventLoop>& loops,
+                  const sockaddr_in* peer) override;
+};
+
+// 按客户端 IP 哈希，同一客户端总是落在同一个 EventLoop
+// 对端地址未知时退化为轮询
+class AddressHashPolicy : public RoundRobinPolicy {
+public:
+    size_t Select(const std::vector<EventLoop>& loops,
+                  const sockaddr_in* peer) override;
+};
+
+}  // namespace skyline::core
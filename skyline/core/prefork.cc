@@ -0,0 +1,138 @@
+#include "prefork.h"
+
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "utils.h"
+
+namespace skyline::core {
+
+static std::time_t nowMsec() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Prefork::Prefork(PreforkOptions options) : options_(options) {
+    if (options_.worker_num == 0) {
+        options_.worker_num =
+            std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+int Prefork::Run(const WorkerMain& worker_main) {
+    sigset_t set, old_set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    ::pthread_sigmask(SIG_BLOCK, &set, &old_set);
+
+    const auto n = options_.worker_num;
+    workers_.assign(n, -1);
+    started_at_.assign(n, 0);
+    // 等待重启的 worker 的重启时间，0 代表无需重启
+    std::vector<std::time_t> respawn_at(n, 0);
+    const pid_t master = ::getpid();
+    auto spawn = [&](unsigned int id) {
+        // 子进程会继承未刷新的缓冲区，退出时重复输出
+        std::cout.flush();
+        std::fflush(nullptr);
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            // master 退出时 worker 随之退出，避免遗留孤儿进程
+            ::prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (::getppid() != master) ::_exit(1);
+            ::pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+            std::exit(worker_main(id));
+        }
+        if (pid == -1) {
+            SYSTEM_LOG_ERROR << "fork worker " << id
+                             << " fail: " << strerror(errno);
+            respawn_at[id] = nowMsec() + options_.respawn_delay;
+            return;
+        }
+        SYSTEM_LOG_INFO << "worker " << id << " started, pid " << pid;
+        workers_[id] = pid;
+        started_at_[id] = nowMsec();
+    };
+    for (unsigned int id = 0; id < n; ++id) spawn(id);
+
+    bool stopping = false;
+    auto alive = [this]() {
+        return std::count_if(workers_.begin(), workers_.end(),
+                             [](pid_t pid) { return pid != -1; });
+    };
+    auto pending = [&respawn_at]() {
+        return std::any_of(respawn_at.begin(), respawn_at.end(),
+                           [](std::time_t t) { return t != 0; });
+    };
+    while (alive() > 0 || (!stopping && pending())) {
+        int sig;
+        if (pending()) {
+            std::time_t next = *std::min_element(
+                respawn_at.begin(), respawn_at.end(),
+                [](std::time_t a, std::time_t b) {
+                    return a != 0 && (b == 0 || a < b);
+                });
+            auto wait = std::max<std::time_t>(next - nowMsec(), 0);
+            ::timespec ts{.tv_sec = wait / 1000,
+                          .tv_nsec = wait % 1000 * 1000000};
+            sig = ::sigtimedwait(&set, nullptr, &ts);
+        } else {
+            sig = ::sigwaitinfo(&set, nullptr);
+        }
+        if ((sig == SIGINT || sig == SIGTERM) && !stopping) {
+            SYSTEM_LOG_INFO << "master stopping, forward signal " << sig;
+            stopping = true;
+            std::fill(respawn_at.begin(), respawn_at.end(), 0);
+            for (auto pid : workers_) {
+                if (pid != -1) ::kill(pid, sig);
+            }
+        }
+        int status;
+        pid_t pid;
+        while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+            auto it = std::find(workers_.begin(), workers_.end(), pid);
+            if (it == workers_.end()) continue;
+            auto id = static_cast<unsigned int>(it - workers_.begin());
+            *it = -1;
+            bool crashed = WIFSIGNALED(status) ||
+                           (WIFEXITED(status) && WEXITSTATUS(status) != 0);
+            if (stopping || !crashed) {
+                SYSTEM_LOG_INFO << "worker " << id << " exited, pid " << pid;
+                continue;
+            }
+            SYSTEM_LOG_ERROR << "worker " << id << " crashed, pid " << pid
+                             << (WIFSIGNALED(status) ? " signal " : " code ")
+                             << (WIFSIGNALED(status) ? WTERMSIG(status)
+                                                     : WEXITSTATUS(status));
+            // 启动后很快退出说明可能无法正常启动，延迟重启避免频繁 fork
+            auto now = nowMsec();
+            respawn_at[id] = now - started_at_[id] < options_.min_uptime
+                                 ? now + options_.respawn_delay
+                                 : now;
+        }
+        if (stopping) continue;
+        auto now = nowMsec();
+        for (unsigned int id = 0; id < n; ++id) {
+            if (respawn_at[id] != 0 && respawn_at[id] <= now) {
+                respawn_at[id] = 0;
+                spawn(id);
+            }
+        }
+    }
+    ::pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+    return 0;
+}
+
+}  // namespace skyline::core
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <ctime>
+#include <functional>
+#include <vector>
+
+namespace skyline::core {
+
+struct PreforkOptions {
+    // worker 进程数，0 为硬件线程数
+    unsigned int worker_num{0};
+    // worker 在启动后该时间内退出视为启动失败，延迟 respawn_delay 再重启
+    std::time_t min_uptime{1000};
+    std::time_t respawn_delay{1000};
+};
+
+// 多进程模式：master 进程只负责创建和监控 worker 进程，
+// 每个 worker 运行各自的 Reactor，互不共享锁和内存分配器
+//
+// 监听 socket 有两种共享方式：
+//   1. master 在 Run 之前调用 TcpServer::CreateListenSocket，worker 继承该 fd
+//      并通过 StartListen(fd) 使用，所有 worker 在同一个 accept 队列上竞争
+//   2. 每个 worker 调用 setReusePort(true) 后自行监听，由内核按连接分配
+//
+// master 中不能在 Run 之前创建线程（包括 Reactor、异步日志），fork 只复制调用线程
+class Prefork {
+public:
+    // 在 worker 进程中执行，返回值作为 worker 进程的退出码
+    using WorkerMain = std::function<int(unsigned int id)>;
+
+    explicit Prefork(PreforkOptions options = {});
+
+    // master：启动 worker，异常退出的 worker 会被重启
+    // 收到 SIGINT/SIGTERM 后转发给所有 worker，等待它们退出后返回 0
+    // worker：执行 worker_main 后直接退出进程，不会返回
+    // worker 启动时信号屏蔽字已恢复，master 退出时 worker 会收到 SIGTERM
+    int Run(const WorkerMain& worker_main);
+
+private:
+    PreforkOptions options_;
+    // 下标为 worker id，值为对应进程 pid，-1 代表未运行
+    std::vector<pid_t> workers_;
+    std::vector<std::time_t> started_at_;
+};
+
+}  // namespace skyline::core
@@ -0,0 +1,80 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+
+namespace skyline::core {
+
+static constexpr uint64_t kUsedBit = uint64_t(1) << 63;
+
+static uint64_t nowNsec() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static uint32_t prefixMask(uint8_t prefix_len) {
+    if (prefix_len == 0) return 0;
+    if (prefix_len >= 32) return ~uint32_t(0);
+    return ~uint32_t(0) << (32 - prefix_len);
+}
+
+RateLimiter::RateLimiter(const RateLimitOptions& options)
+    : interval_ns_(options.rate > 0 ? 1e9 / options.rate : 0),
+      burst_ns_(interval_ns_ * std::max(options.burst, 1.0)),
+      mask_(prefixMask(options.prefix_len)) {
+    auto shards = std::bit_ceil(
+        std::max<size_t>(options.capacity / kSlotsPerShard, 1));
+    shard_mask_ = shards - 1;
+    shards_ = std::make_unique<Shard[]>(shards);
+}
+
+uint64_t RateLimiter::KeyOf(const sockaddr_in& addr) const noexcept {
+    return ntohl(addr.sin_addr.s_addr) & mask_;
+}
+
+bool RateLimiter::Allow(uint64_t key, double cost) noexcept {
+    if (interval_ns_ == 0) return true;
+    const auto now = nowNsec();
+    const auto inc = static_cast<uint64_t>(interval_ns_ * cost);
+    const auto tagged = key | kUsedBit;
+    auto& shard = shards_[(key * 0x9E3779B97F4A7C15ull >> 20) & shard_mask_];
+    for (auto& slot : shard.slots) {
+        if (slot.key.load(std::memory_order_acquire) == tagged) {
+            return Consume(slot.tat, now, inc);
+        }
+    }
+    // 新的键：优先使用空槽位或已补满的桶，否则使用最接近补满的桶
+    Slot* victim = &shard.slots[0];
+    for (auto& slot : shard.slots) {
+        if (slot.tat.load(std::memory_order_relaxed) <
+            victim->tat.load(std::memory_order_relaxed)) {
+            victim = &slot;
+        }
+    }
+    auto old = victim->key.load(std::memory_order_relaxed);
+    if (victim->key.compare_exchange_strong(old, tagged,
+                                            std::memory_order_acq_rel)) {
+        // 新桶是满的；与旧键的并发扣减之间存在竞争，最多造成一次误差
+        victim->tat.store(0, std::memory_order_relaxed);
+    } else if (old != tagged) {
+        // 槽位刚被其它键占用，放行本次请求，不为此重试
+        return true;
+    }
+    return Consume(victim->tat, now, inc);
+}
+
+bool RateLimiter::Consume(std::atomic_uint64_t& tat, uint64_t now,
+                          uint64_t inc) const noexcept {
+    auto cur = tat.load(std::memory_order_relaxed);
+    while (true) {
+        const auto next = std::max(cur, now) + inc;
+        if (next - now > burst_ns_) return false;
+        if (tat.compare_exchange_weak(cur, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+}  // namespace skyline::core
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace skyline::core {
+
+// 令牌桶限流参数
+struct RateLimitOptions {
+    // 每秒补充的令牌数，0 为不限制
+    double rate{0};
+    // 桶容量，即允许的突发数
+    double burst{1};
+    // 按 IPv4 地址的前 prefix_len 位聚合，例如 24 表示同一 /24 网段共享一个桶
+    uint8_t prefix_len{32};
+    // 最多同时跟踪的客户端数
+    size_t capacity{65536};
+};
+
+// 按客户端地址限流的令牌桶，可在任意线程中并发调用，无锁
+// 使用 GCRA 算法，每个桶只保存“理论到达时间”，一次 CAS 即可完成检查与扣减
+// 哈希表按缓存行分片，每个键只在所属分片的几个槽位中查找，检查的代价为 O(1)
+// 令牌已补满的桶与不存在的桶等价，可以直接被其它键复用，因此不需要单独清理；
+// 分片的槽位都在限流中时，复用最接近补满的一个
+class RateLimiter {
+public:
+    explicit RateLimiter(const RateLimitOptions& options);
+    RateLimiter(const RateLimiter&) = delete;
+
+    // 消耗 cost 个令牌，令牌不足时返回 false 且不消耗
+    bool Allow(const sockaddr_in& addr, double cost = 1) noexcept {
+        return Allow(KeyOf(addr), cost);
+    }
+    // key 的最高位保留，不能使用
+    bool Allow(uint64_t key, double cost = 1) noexcept;
+
+    // addr 按 prefix_len 聚合后的键
+    uint64_t KeyOf(const sockaddr_in& addr) const noexcept;
+
+private:
+    struct Slot {
+        std::atomic_uint64_t key{0};  // 0 为空槽位
+        std::atomic_uint64_t tat{0};  // 理论到达时间，单位纳秒
+    };
+    static constexpr size_t kSlotsPerShard = 4;
+    struct alignas(64) Shard {
+        std::array<Slot, kSlotsPerShard> slots;
+    };
+
+    // 在 tat 上扣减 inc 纳秒对应的令牌
+    bool Consume(std::atomic_uint64_t& tat, uint64_t now,
+                 uint64_t inc) const noexcept;
+
+private:
+    double interval_ns_;  // 补充一个令牌的时间
+    uint64_t burst_ns_;   // 补满整个桶的时间
+    uint32_t mask_;
+    size_t shard_mask_;
+    std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace skyline::core
@@ -1,19 +1,97 @@
 #include "reactor.h"
 
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "utils.h"
+
 static const unsigned int kThreadNum = std::thread::hardware_concurrency();
+// 每次事件循环最多执行的调度任务数，避免长时间饿死 I/O 事件
+static constexpr size_t kTaskBudget = 16;
 
 namespace skyline::core {
 
+static std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof set, &set) == -1) return cpus;
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &set)) cpus.push_back(i);
+    }
+    return cpus;
+}
+
+static skyline::core::ReactorOptions clampOptions(unsigned int sub_reactor_num) {
+    if (sub_reactor_num > kThreadNum) {
+        SYSTEM_LOG_WARN << "sub reactor num " << sub_reactor_num
+                        << " is limited to hardware concurrency "
+                        << kThreadNum;
+        sub_reactor_num = kThreadNum;
+    }
+    return {.sub_reactor_num = sub_reactor_num};
+}
+
 Reactor::Reactor(unsigned int sub_reactor_num)
-    : sub_reactors_(std::min(kThreadNum, sub_reactor_num)) {}
+    : Reactor(clampOptions(sub_reactor_num)) {}
+
+Reactor::Reactor(ReactorOptions options)
+    : options_(std::move(options)),
+      sub_reactors_(options_.sub_reactor_num),
+      scheduler_(std::max<size_t>(1, sub_reactors_.size())),
+      placement_(std::make_unique<RoundRobinPolicy>()) {
+    auto run_tasks = [this]() { return scheduler_.RunOnce(kTaskBudget); };
+    main_reactor.setBusyPoll(options_.busy_poll);
+    for (auto& loop : sub_reactors_) loop.setBusyPoll(options_.busy_poll);
+    if (sub_reactors_.empty()) {
+        scheduler_.setWorkerLoop(0, &main_reactor);
+        main_reactor.setIterationCallback(run_tasks);
+    }
+    for (size_t i = 0; i < sub_reactors_.size(); ++i) {
+        scheduler_.setWorkerLoop(i, &sub_reactors_[i]);
+        sub_reactors_[i].setIterationCallback(run_tasks);
+    }
+    if (options_.sub_reactor_num > kThreadNum) {
+        SYSTEM_LOG_WARN << "sub reactor num " << options_.sub_reactor_num
+                        << " exceeds hardware concurrency " << kThreadNum;
+    }
+    // 自动绑定：每个子反应堆独占一个 CPU，跳过主反应堆使用的 CPU
+    if (options_.auto_pin && options_.sub_reactor_cpus.empty()) {
+        for (auto cpu : allowedCpus()) {
+            if (std::find(options_.main_reactor_cpus.begin(),
+                          options_.main_reactor_cpus.end(),
+                          cpu) == options_.main_reactor_cpus.end()) {
+                options_.sub_reactor_cpus.push_back({cpu});
+            }
+        }
+        if (options_.sub_reactor_cpus.size() < sub_reactors_.size()) {
+            SYSTEM_LOG_WARN << "only " << options_.sub_reactor_cpus.size()
+                            << " cpus for " << sub_reactors_.size()
+                            << " sub reactors, some cpus will be shared";
+        }
+    }
+}
 
 Reactor::~Reactor() { Stop(); }
 
 void Reactor::Start() {
     // start sub reactor loop
-    for (auto& reactor : sub_reactors_) {
-        sub_threads_.emplace_back([&reactor]() { reactor.Loop(); });
+    for (size_t i = 0; i < sub_reactors_.size(); ++i) {
+        sub_threads_.emplace_back([this, i]() {
+            SetupThread(SubReactorCpus(i),
+                        options_.thread_name + "-sub" + std::to_string(i));
+            scheduler_.BindWorker(i);
+            sub_reactors_[i].Loop();
+        });
     }
+    SetupThread(options_.main_reactor_cpus, options_.thread_name + "-main");
+    if (sub_reactors_.empty()) scheduler_.BindWorker(0);
     main_reactor.Loop();
 }
 
@@ -28,11 +106,74 @@ void Reactor::Stop() {
     }
 }
 
-EventLoop& Reactor::NextLoop() noexcept {
-    return this->sub_reactors_.empty()
-               ? this->main_reactor
-               : this->sub_reactors_[this->cur_reactor_id_++ %
-                                     this->sub_reactors_.size()];
+void Reactor::SetupThread(const std::vector<int>& cpus,
+                          const std::string& name) {
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu : cpus) CPU_SET(cpu, &set);
+        if (auto err = ::pthread_setaffinity_np(::pthread_self(), sizeof set,
+                                                &set)) {
+            SYSTEM_LOG_ERROR << "set affinity fail: " << name << " "
+                             << strerror(err);
+        }
+    }
+    // 本地节点优先，之后在本线程中分配的内存位于所绑定 CPU 的节点
+    // 作用于本线程及之后由它创建的线程，主反应堆所在的线程只有绑定了 CPU 才设置
+    if (options_.numa_local && !cpus.empty() &&
+        ::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) == -1 &&
+        errno != ENOSYS) {
+        SYSTEM_LOG_WARN << "set mempolicy fail: " << name << " "
+                        << strerror(errno);
+    }
+    // 进程主线程的名字就是进程名，不修改，避免影响 ps/pkill 等工具
+    if (!options_.thread_name.empty() && ::syscall(SYS_gettid) != ::getpid()) {
+        // 线程名最长 15 个字符
+        ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str());
+    }
+}
+
+const std::vector<int>& Reactor::SubReactorCpus(size_t id) {
+    static const std::vector<int> kNone;
+    if (options_.sub_reactor_cpus.empty()) return kNone;
+    return options_.sub_reactor_cpus[id % options_.sub_reactor_cpus.size()];
+}
+
+void Reactor::Spawn(TaskScheduler::Task task) {
+    scheduler_.Spawn(std::move(task));
+}
+
+void Reactor::setPlacementPolicy(std::unique_ptr<PlacementPolicy> policy) {
+    if (policy) placement_.swap(policy);
+}
+
+size_t Reactor::loopIndex(const EventLoop& loop) const noexcept {
+    if (&loop == &main_reactor) return 0;
+    return &loop - sub_reactors_.data() + 1;
+}
+
+EventLoop& Reactor::loopAt(size_t index) noexcept {
+    return index == 0 ? main_reactor : sub_reactors_[index - 1];
+}
+
+EventLoop& Reactor::NextLoop(const sockaddr_in* peer) noexcept {
+    if (sub_reactors_.empty()) return main_reactor;
+    return sub_reactors_[placement_->Select(sub_reactors_, peer)];
+}
+
+EventLoop* Reactor::NextLoop(const sockaddr_in* peer,
+                             size_t max_connections) noexcept {
+    auto& loop = NextLoop(peer);
+    if (max_connections == 0 || loop.connectionCount() < max_connections) {
+        return &loop;
+    }
+    if (sub_reactors_.empty()) return nullptr;
+    auto least = std::min_element(
+        sub_reactors_.begin(), sub_reactors_.end(),
+        [](const EventLoop& a, const EventLoop& b) {
+            return a.connectionCount() < b.connectionCount();
+        });
+    return least->connectionCount() < max_connections ? &*least : nullptr;
 }
 
 }  // namespace skyline::core
@@ -1,29 +1,80 @@
 #pragma once
 
 #include "event_loop.h"
+#include "placement_policy.h"
+#include "task_scheduler.h"
 
 namespace skyline::core {
 
+struct ReactorOptions {
+    // 子反应堆数目，0 为单反应堆模式，不会被限制为硬件线程数
+    unsigned int sub_reactor_num{0};
+    // 第 i 个子反应堆绑定到 sub_reactor_cpus[i % size()]，为空时不绑定
+    std::vector<std::vector<int>> sub_reactor_cpus;
+    // 主反应堆（调用 Start 的线程）绑定的 CPU 集合，为空时不绑定
+    std::vector<int> main_reactor_cpus;
+    // sub_reactor_cpus 为空时，为每个子反应堆自动分配一个 CPU
+    // 会跳过 main_reactor_cpus，使主反应堆独占自己的核心
+    bool auto_pin{false};
+    // 为绑定了 CPU 的反应堆线程设置本地节点优先的内存策略，
+    // 会覆盖该线程继承的进程级策略（例如 numactl --interleave），默认关闭
+    // 未绑定的线程可能在节点之间迁移，不设置
+    bool numa_local{false};
+    // 所有反应堆的忙轮询配置，默认关闭
+    BusyPollOptions busy_poll;
+    // 线程名前缀，线程名为 <prefix>-main、<prefix>-sub<i>，为空时不命名
+    // 主反应堆运行在进程主线程时保留进程名
+    std::string thread_name{"skyline"};
+};
+
 class Reactor {
 public:
     // 默认子反应堆数目为0，即单反应堆模式
+    // 子反应堆数目超过硬件线程数时会被限制，并输出警告
     explicit Reactor(unsigned int sub_reactor_num = 0);
+    explicit Reactor(ReactorOptions options);
     ~Reactor();
 
     void Start();
     void Stop();
 
-    EventLoop& NextLoop() noexcept;
+    // 按放置策略选择一个子反应堆，peer 为新连接的对端地址（可为空）
+    EventLoop& NextLoop(const sockaddr_in* peer = nullptr) noexcept;
+    // 同上，但所选 EventLoop 的 socket 数已达 max_connections 时
+    // 改选 socket 数最少的子反应堆，全部已满时返回空；max_connections 为 0 时不限制
+    EventLoop* NextLoop(const sockaddr_in* peer,
+                        size_t max_connections) noexcept;
+
+    // EventLoop 的总数（主反应堆与所有子反应堆）以及 loop 的序号，主反应堆为 0
+    // 用于按 EventLoop 划分状态，每份只在对应的线程中访问，不需要加锁
+    size_t loopCount() const noexcept { return sub_reactors_.size() + 1; }
+    size_t loopIndex(const EventLoop& loop) const noexcept;
+    EventLoop& loopAt(size_t index) noexcept;
+
+    // 设置新连接放置策略，默认为轮询，应在 Start 之前调用
+    void setPlacementPolicy(std::unique_ptr<PlacementPolicy> policy);
+
+    // 提交一个 CPU 任务，由各子反应堆（单反应堆模式下为主反应堆）
+    // 在事件循环间隙执行，空闲的反应堆会窃取繁忙反应堆的任务
+    void Spawn(TaskScheduler::Task task);
+
+    TaskScheduler& scheduler() noexcept { return scheduler_; }
 
 public:
     EventLoop main_reactor;
 
 private:
+    // 在反应堆线程中调用，设置亲和性、内存策略以及线程名
+    void SetupThread(const std::vector<int>& cpus, const std::string& name);
+    const std::vector<int>& SubReactorCpus(size_t id);
+
+private:
+    ReactorOptions options_;
     std::vector<EventLoop> sub_reactors_;
     std::vector<std::thread> sub_threads_;
+    TaskScheduler scheduler_;
 
-    // 记录当前应使用的子反应堆号，用于平均分配 fd
-    size_t cur_reactor_id_{0};
+    std::unique_ptr<PlacementPolicy> placement_;
 };
 
 }  // namespace skyline::core
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+namespace skyline::core {
+
+// 非原子的侵入式引用计数基类
+// 计数只能在对象所属的线程（对连接而言是其 EventLoop 线程）中增减，
+// 需要跨线程持有时使用 ChannelHandle 之类的显式句柄
+class RefCounted {
+public:
+    RefCounted() = default;
+    RefCounted(const RefCounted&) = delete;
+    RefCounted& operator=(const RefCounted&) = delete;
+
+    void AddRef() const noexcept { ++refs_; }
+    void Release() const noexcept {
+        if (--refs_ == 0) Destroy();
+    }
+
+    uint32_t refCount() const noexcept { return refs_; }
+
+protected:
+    virtual ~RefCounted() = default;
+
+    // 计数归零时调用，默认直接 delete，子类可以改为归还对象池
+    virtual void Destroy() const { delete this; }
+
+private:
+    mutable uint32_t refs_{0};
+};
+
+// 配合 RefCounted 使用的智能指针，语义与 std::shared_ptr 相同，但计数非原子
+template <typename T>
+class RefPtr {
+public:
+    RefPtr() noexcept = default;
+    RefPtr(std::nullptr_t) noexcept {}
+    RefPtr(T* ptr) noexcept : ptr_(ptr) {
+        if (ptr_) ptr_->AddRef();
+    }
+    RefPtr(const RefPtr& other) noexcept : RefPtr(other.ptr_) {}
+    RefPtr(RefPtr&& other) noexcept : ptr_(std::exchange(other.ptr_, nullptr)) {}
+    template <typename U>
+    RefPtr(const RefPtr<U>& other) noexcept : RefPtr(other.get()) {}
+    template <typename U>
+    RefPtr(RefPtr<U>&& other) noexcept : ptr_(other.Detach()) {}
+    ~RefPtr() {
+        if (ptr_) ptr_->Release();
+    }
+
+    RefPtr& operator=(RefPtr other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+
+    void reset() noexcept { RefPtr().swap(*this); }
+    void swap(RefPtr& other) noexcept { std::swap(ptr_, other.ptr_); }
+
+    T* get() const noexcept { return ptr_; }
+    T* operator->() const noexcept { return ptr_; }
+    T& operator*() const noexcept { return *ptr_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+    // 放弃所有权但不减少计数，用于转换类型时的移动
+    T* Detach() noexcept { return std::exchange(ptr_, nullptr); }
+
+    friend bool operator==(const RefPtr& lhs, const RefPtr& rhs) noexcept {
+        return lhs.ptr_ == rhs.ptr_;
+    }
+    friend bool operator==(const RefPtr& lhs, std::nullptr_t) noexcept {
+        return lhs.ptr_ == nullptr;
+    }
+
+private:
+    T* ptr_{nullptr};
+};
+
+template <typename T, typename... Args>
+RefPtr<T> MakeRef(Args&&... args) {
+    return RefPtr<T>(new T(std::forward<Args>(args)...));
+}
+
+}  // namespace skyline::core
@@ -1,16 +1,18 @@
 #include "socket_context.h"
 
+#include "event_loop.h"
+
 namespace skyline::core::detail {
 
 SocketContext::SocketContext(EventLoop& loop, int fd, uint32_t events)
-    : Channel(loop, fd), events(events) {}
+    : Channel(loop, fd), events(events), write_buffer_(&loop.bufferPool()) {}
 
 bool SocketContext::HandleWriteEvent() {
     if (write_buffer_.size() > 0) {
         auto bytes_write =
             ::write(fd(), write_buffer_.data(), write_buffer_.size());
         if (bytes_write < 0) return false;
-        write_buffer_.Read(bytes_write);
+        write_buffer_.Retrieve(bytes_write);
     }
     return true;
 }
@@ -16,9 +16,18 @@ public:
 
     // 将剩余数据发送，返回当前socket是否继续可用
     // 如果对端关闭，则无法继续使用
-    bool HandleWriteEvent();
+    virtual bool HandleWriteEvent();
 
-    bool NeedWrite() { return write_buffer_.size() > 0; }
+    // 发生错误，即将从 EventLoop 中移除前调用
+    virtual void HandleErrorEvent() {}
+
+    // 加入 EventLoop 之后、处理任何事件之前，在 EventLoop 线程中调用
+    virtual void HandleAddedEvent() {}
+    // 从 EventLoop 中移除之后调用，之后不会再收到任何事件
+    virtual void HandleRemovedEvent() { closed_ = true; }
+
+    // 返回 false 时 EventLoop 将停止监听可写事件
+    virtual bool NeedWrite() { return write_buffer_.size() > 0; }
 
 public:
     uint32_t events{0};
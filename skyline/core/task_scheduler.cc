@@ -0,0 +1,122 @@
+#include "task_scheduler.h"
+
+#include <random>
+
+#include "event_loop.h"
+#include "utils.h"
+
+namespace skyline::core {
+
+static thread_local TaskScheduler* kCurrentScheduler = nullptr;
+static thread_local size_t kCurrentWorker = 0;
+
+static size_t randomIndex(size_t n) {
+    static thread_local std::minstd_rand engine(std::random_device{}());
+    return engine() % n;
+}
+
+TaskScheduler::TaskScheduler(size_t worker_num) {
+    if (worker_num == 0) worker_num = 1;
+    for (size_t i = 0; i < worker_num; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    for (auto& w : workers_) {
+        while (auto task = w->deque.Take()) delete task;
+    }
+    for (auto task : inject_) delete task;
+}
+
+void TaskScheduler::setWorkerLoop(size_t id, EventLoop* loop) {
+    workers_[id]->loop = loop;
+}
+
+void TaskScheduler::BindWorker(size_t id) {
+    kCurrentScheduler = this;
+    kCurrentWorker = id;
+}
+
+TaskScheduler* TaskScheduler::current() noexcept { return kCurrentScheduler; }
+
+void TaskScheduler::Spawn(Task task) {
+    if (!task) return;
+    auto item = new Task(std::move(task));
+    size_t self = workers_.size();
+    if (kCurrentScheduler == this) {
+        self = kCurrentWorker;
+        workers_[self]->deque.Push(item);
+    } else {
+        std::lock_guard lock(inject_mtx_);
+        inject_.push_back(item);
+    }
+    pending_.fetch_add(1, std::memory_order_seq_cst);
+    WakeupIdle(self);
+}
+
+bool TaskScheduler::RunOnce(size_t budget) {
+    auto id = kCurrentWorker;
+    auto& worker = *workers_[id];
+    worker.idle.store(false, std::memory_order_relaxed);
+    for (size_t n = 0; n < budget; ++n) {
+        auto task = Next(id);
+        if (task == nullptr) break;
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+        try {
+            (*task)();
+        } catch (const std::exception& e) {
+            SYSTEM_LOG_ERROR << "scheduler task exit with exception: "
+                             << e.what();
+        } catch (...) {
+            SYSTEM_LOG_ERROR << "scheduler task exit with unknown exception";
+        }
+        delete task;
+    }
+    // 先声明空闲再检查是否有任务，与 Spawn 中先计数再检查空闲配合，避免丢失唤醒
+    worker.idle.store(true, std::memory_order_seq_cst);
+    if (pending_.load(std::memory_order_seq_cst) > 0) {
+        worker.idle.store(false, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+TaskScheduler::Task* TaskScheduler::Next(size_t id) {
+    if (auto task = workers_[id]->deque.Take()) return task;
+    {
+        std::lock_guard lock(inject_mtx_);
+        if (!inject_.empty()) {
+            auto task = inject_.front();
+            inject_.pop_front();
+            return task;
+        }
+    }
+    // 从随机位置开始，依次尝试窃取其它 worker 的任务
+    const auto n = workers_.size();
+    if (n <= 1) return nullptr;
+    auto start = randomIndex(n);
+    for (size_t i = 0; i < n; ++i) {
+        auto victim = (start + i) % n;
+        if (victim == id) continue;
+        if (auto task = workers_[victim]->deque.Steal()) return task;
+    }
+    return nullptr;
+}
+
+void TaskScheduler::WakeupIdle(size_t except) {
+    const auto n = workers_.size();
+    auto start = randomIndex(n);
+    for (size_t i = 0; i < n; ++i) {
+        auto id = (start + i) % n;
+        if (id == except) continue;
+        auto& w = *workers_[id];
+        if (w.loop && w.idle.load(std::memory_order_seq_cst) &&
+            w.idle.exchange(false)) {
+            w.loop->Wakeup();
+            return;
+        }
+    }
+}
+
+}  // namespace skyline::core
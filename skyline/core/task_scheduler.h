@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+namespace skyline::core {
+
+class EventLoop;
+
+namespace detail {
+
+// Chase-Lev 工作窃取双端队列
+// 只有拥有者线程可以 Push/Take（从底部操作），其它线程只能 Steal（从顶部操作）
+// 容量不足时自动扩容，旧数组在队列析构时才释放，保证并发窃取者不会访问已释放内存
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = 256)
+        : array_(new Array(capacity)) {
+        retired_.emplace_back(array_.load(std::memory_order_relaxed));
+    }
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+
+    void Push(T* item) {
+        auto b = bottom_.load(std::memory_order_relaxed);
+        auto t = top_.load(std::memory_order_acquire);
+        auto a = array_.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->capacity) - 1) a = Grow(a, b, t);
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    T* Take() {
+        auto b = bottom_.load(std::memory_order_relaxed) - 1;
+        auto a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* item = a->get(b);
+        if (t == b) {
+            // 最后一个元素，与窃取者竞争
+            if (!top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    T* Steal() {
+        auto t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+        auto a = array_.load(std::memory_order_acquire);
+        T* item = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    bool empty() const noexcept {
+        return bottom_.load(std::memory_order_relaxed) <=
+               top_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Array {
+        explicit Array(size_t capacity)
+            : capacity(capacity), mask(capacity - 1), slots(capacity) {}
+
+        void put(int64_t i, T* item) noexcept {
+            slots[i & mask].store(item, std::memory_order_relaxed);
+        }
+        T* get(int64_t i) const noexcept {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+
+        const size_t capacity;  // 必须为 2 的幂
+        const size_t mask;
+        std::vector<std::atomic<T*>> slots;
+    };
+
+    Array* Grow(Array* a, int64_t b, int64_t t) {
+        auto bigger = new Array(a->capacity * 2);
+        for (auto i = t; i < b; ++i) bigger->put(i, a->get(i));
+        retired_.emplace_back(bigger);
+        array_.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> retired_;  // 只由拥有者线程访问
+};
+
+}  // namespace detail
+
+// 在多个 EventLoop 线程间共享的工作窃取任务调度器
+// 每个 worker 对应一个 EventLoop，在两次 epoll_wait 之间执行任务：
+// 先执行自己队列中的任务，再取公共队列，最后随机从其它 worker 窃取
+// 空闲的 worker 阻塞在 epoll_wait 中，有新任务时会被唤醒
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    explicit TaskScheduler(size_t worker_num);
+    TaskScheduler(const TaskScheduler&) = delete;
+    ~TaskScheduler();
+
+    // 设置 worker 对应的 EventLoop，需要在 worker 线程启动前调用
+    void setWorkerLoop(size_t id, EventLoop* loop);
+
+    // 将当前线程绑定为 id 号 worker，需要在对应线程中调用
+    void BindWorker(size_t id);
+
+    // 提交任务，可在任意线程调用
+    // 在 worker 线程中提交时放入自己的队列，否则放入公共队列
+    void Spawn(Task task);
+
+    // 在 worker 线程的事件循环间隙调用，最多执行 budget 个任务
+    // 返回 true 表示可能仍有待执行的任务，事件循环不应阻塞等待
+    bool RunOnce(size_t budget);
+
+    size_t workerNum() const noexcept { return workers_.size(); }
+
+    // 当前线程绑定的调度器，非 worker 线程返回空指针
+    static TaskScheduler* current() noexcept;
+
+private:
+    struct Worker {
+        detail::WorkStealingDeque<Task> deque;
+        EventLoop* loop{nullptr};
+        std::atomic_bool idle{true};  // 尚未运行的 worker 视为阻塞中
+    };
+
+    Task* Next(size_t id);
+    // 唤醒一个空闲的 worker，不唤醒 except 号 worker
+    void WakeupIdle(size_t except);
+
+private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex inject_mtx_;
+    std::deque<Task*> inject_;
+    std::atomic_size_t pending_{0};  // 已提交但未被取出的任务数
+};
+
+}  // namespace skyline::core
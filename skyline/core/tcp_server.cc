@@ -3,66 +3,79 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 
+#include <algorithm>
 #include <cstring>
 
+#include "memory_pool.h"
 #include "reactor.h"
 #include "socket_context.h"
+#include "throughput.h"
 #include "utils.h"
 
 static constexpr size_t kReadBufferLen = 1024;
+// 一次读事件中累积到该大小就交给上层处理，不超过缓冲区池的最大块
+static constexpr size_t kMaxPendingRead =
+    skyline::core::BufferPool::kTiers.back();
 
 namespace skyline::core {
 
 namespace detail {
 
-// 负责创建监听 socket，并启动监听
+// 负责在一个处于监听状态的 socket 上接收新连接
+// 过载或文件描述符耗尽时暂停监听可读事件，新连接留在内核的监听队列中，
+// 一段时间后再重新尝试，而不是把监听 socket 从 EventLoop 中移除
 class Acceptor : public SocketContext {
 public:
-    using AfterAcceptCallback = std::function<void(int)>;
+    // 返回 false 表示无法再接收新连接，Acceptor 将暂停一段时间
+    using AdmitCallback = std::function<bool()>;
+    using AfterAcceptCallback = std::function<bool(int, const sockaddr_in&)>;
 
-    Acceptor(EventLoop& loop, const sockaddr_in& addr)
-        : SocketContext(loop, socket(AF_INET, SOCK_STREAM, 0),
-                        EPOLLIN | EPOLLPRI) {
-        if (fd() == -1) {
-            SYSTEM_LOG_FATAL << "server socket create fail: "
-                             << strerror(errno);
-            throw "socket create fail";
-        }
-        int opt = 1;
-        if (::setsockopt(fd(), SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt) ==
-            -1) {
-            SYSTEM_LOG_FATAL << "set reuse addr fail: [" << fd() << "] "
-                             << strerror(errno);
-            throw "set reuse addr fail";
-        }
-        if (::bind(fd(), (sockaddr*)&addr, sizeof addr) == -1) {
-            SYSTEM_LOG_FATAL << "addr bind fail: [" << fd() << "] "
-                             << strerror(errno);
-            throw "socket addr bind fail";
-        }
+    Acceptor(EventLoop& loop, int listen_fd, std::time_t retry_ms)
+        : SocketContext(loop, listen_fd, EPOLLIN | EPOLLPRI),
+          retry_ms_(retry_ms) {
         if (fcntl(fd(), F_SETFL, fcntl(fd(), F_GETFL) | O_NONBLOCK) == -1) {
             SYSTEM_LOG_FATAL << "set nonblock fail: [" << fd() << "] "
                              << strerror(errno);
             throw "set nonblock fail";
         }
-        if (::listen(fd(), SOMAXCONN) == -1) {
-            SYSTEM_LOG_FATAL << "listen fail: [" << fd() << "] "
-                             << strerror(errno);
-            throw "listen fail";
-        }
-        SYSTEM_LOG_INFO << "server listen in: " << inet_ntoa(addr.sin_addr)
-                        << ":" << ::ntohs(addr.sin_port);
     }
 
     bool HandleReadEvent() override {
-        auto clnt_sockfd = ::accept(fd(), NULL, NULL);
+        if (admit_ && !admit_()) {
+            Pause("connection limit reached");
+            return true;
+        }
+        sockaddr_in peer{};
+        socklen_t len = sizeof peer;
+        // 连接 socket 不能被 exec 出的新进程继承，否则关闭连接时对端收不到 FIN
+        auto clnt_sockfd =
+            ::accept4(fd(), (sockaddr*)&peer, &len, SOCK_CLOEXEC);
         if (clnt_sockfd == -1) {
-            if ((errno == EAGAIN || errno == EWOULDBLOCK)) {
-                return true;
+            switch (errno) {
+                case EAGAIN:
+                case EINTR:
+                case ECONNABORTED:
+                case EPROTO:
+                case EPERM:
+                    return true;
+                // 资源耗尽，监听 socket 会一直可读，必须暂停以免空转
+                case EMFILE:
+                case ENFILE:
+                case ENOBUFS:
+                case ENOMEM:
+                    Pause(strerror(errno));
+                    return true;
+                default:
+                    SYSTEM_LOG_ERROR << "accept fail: [" << fd() << "] "
+                                     << strerror(errno);
+                    return false;
             }
-            return false;
         }
-        if (after_accept_) after_accept_(clnt_sockfd);
+        if (after_accept_ && !after_accept_(clnt_sockfd, peer)) {
+            Pause("all event loops are full");
+            return true;
+        }
+        overloaded_ = false;
         return true;
     }
 
@@ -71,23 +84,58 @@ public:
     // 被动监听的 socket 不需要实现该方法
     void SendMassage(const std::string_view& massage) override {}
 
+    void setAdmitCallback(AdmitCallback fun) noexcept {
+        admit_ = std::move(fun);
+    }
     void setAfterAcceptCallback(AfterAcceptCallback fun) noexcept {
         after_accept_ = std::move(fun);
     }
 
 private:
+    void Pause(const char* reason) {
+        if (paused_) return;
+        paused_ = true;
+        // 持续过载时只在第一次暂停时输出日志
+        if (!overloaded_) {
+            overloaded_ = true;
+            SYSTEM_LOG_WARN << "accept paused: [" << fd() << "] " << reason;
+        }
+        loop_.UpdateSocketContext(fd(), 0);
+        // 定时器持有引用，监听 socket 在定时器触发前不会关闭，fd 不会被复用
+        loop_.AddTimer(retry_ms_, [self = RefPtr<Acceptor>(this)](auto) {
+            self->paused_ = false;
+            if (!self->isClosed()) {
+                self->loop_.UpdateSocketContext(self->fd(), self->events);
+            }
+        });
+    }
+
+private:
+    AdmitCallback admit_;
     AfterAcceptCallback after_accept_;
+    std::time_t retry_ms_;
+    bool paused_{false};
+    bool overloaded_{false};
 };
 
-// 负责管理一个连接 socket
-class Connection : public SocketContext,
-                   public std::enable_shared_from_this<Connection> {
+// 负责管理一个连接 socket，所有回调都在所属 EventLoop 线程中调用
+class Connection : public SocketContext {
 public:
-    using HandleMassageCallback =
-        std::function<void(std::shared_ptr<Channel>, ReadBuffer&)>;
+    // 从 loop 的内存池中分配，必须在 loop 线程中调用
+    static RefPtr<Connection> Create(EventLoop& loop, int fd,
+                                     const sockaddr_in& peer,
+                                     TcpServer& server) {
+        void* mem = loop.slab().Allocate(sizeof(Connection));
+        return RefPtr<Connection>(
+            new (mem) Connection(loop, fd, peer, server));
+    }
 
-    Connection(EventLoop& loop, int fd)
-        : SocketContext(loop, fd, EPOLLIN | EPOLLPRI | EPOLLET) {
+    Connection(EventLoop& loop, int fd, const sockaddr_in& peer,
+               TcpServer& server)
+        : SocketContext(loop, fd, EPOLLIN | EPOLLPRI | EPOLLET),
+          server_(server),
+          read_buffer_(&loop.bufferPool()) {
+        setPeerAddr(peer);
         if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
             SYSTEM_LOG_ERROR << "set nonblock fail: [" << fd << "] "
                              << strerror(errno);
@@ -95,21 +143,36 @@ public:
         }
     }
 
+    // 没能加入 EventLoop 的连接在这里减少计数
+    // 加入后的连接在移除时减少，EventLoop 析构时丢弃的连接不再访问 server_
+    ~Connection() override {
+        if (!added_) --server_.conn_count_;
+    }
+
     bool HandleReadEvent() override {
         char buf[kReadBufferLen];
         ssize_t cnt = 0;
         while (true) {
             auto bytes_read = ::read(fd(), buf, sizeof buf);
             if (bytes_read > 0) {
-                if (massage_handler_) read_buffer_.Write(buf, bytes_read);
+                // 未处理的数据超出缓冲区上限，关闭连接
+                if (!read_buffer_.WriteAll(
+                        {buf, static_cast<size_t>(bytes_read)})) {
+                    return false;
+                }
                 cnt += bytes_read;
+                // 对端持续发送时不等到 EAGAIN，先交给上层处理，
+                // 上层可能关闭连接或暂停读取，剩余数据留在内核缓冲区
+                if (read_buffer_.size() >= kMaxPendingRead) {
+                    server_.OnRecv(ChannelPtr(this), read_buffer_);
+                    if (isClosed() || !(events & EPOLLIN)) return true;
+                }
             } else if (bytes_read == -1 && errno == EINTR) {
                 continue;
             } else if (bytes_read == -1 &&
                        (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                if (massage_handler_) {
-                    massage_handler_(shared_from_this(), read_buffer_);
-                }
+                // 回调中可能关闭连接，持有一个引用直到回调结束
+                server_.OnRecv(ChannelPtr(this), read_buffer_);
                 return true;
             } else if (bytes_read == 0) {
                 return false;
@@ -118,29 +181,138 @@ public:
         return false;
     }
 
+    bool HandleWriteEvent() override {
+        const auto pending = write_buffer_.size();
+        if (!SocketContext::HandleWriteEvent()) return false;
+        if (send_meter_) {
+            send_meter_->Add(ThroughputMeter::NowMsec(),
+                             pending - write_buffer_.size());
+        }
+        return true;
+    }
+
+    void HandleAddedEvent() override {
+        added_ = true;
+        server_.AfterConnect(ChannelPtr(this));
+    }
+
+    void HandleRemovedEvent() override {
+        SocketContext::HandleRemovedEvent();
+        --server_.conn_count_;
+        server_.OnClose(ChannelPtr(this));
+    }
+
+    // 可在任意线程调用，非 Loop 线程调用时会复制一份数据再投递
     void SendMassage(const std::string_view& massage) override {
-        loop_.RunInLoop([this, &massage]() {
-            auto bytes_write =
-                ::write(this->fd(), massage.data(), massage.size());
-            if (bytes_write < 0) {
+        if (loop_.isInLoopThread()) {
+            SendInLoop(massage);
+        } else {
+            // 调用方持有句柄，这里只增加句柄计数
+            loop_.RunInLoop([handle = ChannelHandle::Retain(this),
+                             data = std::string(massage)]() {
+                static_cast<Connection*>(handle.get().get())->SendInLoop(data);
+            });
+        }
+    }
+
+    void Close() override { this->loop_.RemoveSocketContext(this->fd()); }
+
+    // 重新加入 EPOLLIN 时 epoll 会重新检查可读状态，边缘触发下不会丢失事件
+    void PauseRead() override {
+        if (isClosed() || !(events & EPOLLIN)) return;
+        events &= ~EPOLLIN;
+        loop_.UpdateSocketContext(fd(), events);
+    }
+
+    void ResumeRead() override {
+        if (isClosed() || (events & EPOLLIN)) return;
+        events |= EPOLLIN;
+        loop_.UpdateSocketContext(fd(), events);
+    }
+
+protected:
+    // 归还到所属 loop 的内存池，最后一个引用总是在 loop 线程中释放
+    void Destroy() const override {
+        auto self = const_cast<Connection*>(this);
+        auto& slab = loop_.slab();
+        self->~Connection();
+        slab.Deallocate(self, sizeof(Connection));
+    }
+
+private:
+    void SendInLoop(std::string_view massage) {
+        if (fd() == -1) return;
+        // 已有待发送数据时必须追加到缓冲区，保证数据的先后顺序
+        if (NeedWrite()) {
+            if (!write_buffer_.WriteAll(massage)) SendOverflow();
+            return;
+        }
+        auto bytes_write = ::write(this->fd(), massage.data(), massage.size());
+        if (bytes_write < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
                 Close();
-            } else if (bytes_write < massage.size()) {
-                write_buffer_.WriteAll(massage.substr(bytes_write));
-                this->events |= EPOLLOUT;
-                loop_.UpdateSocketContext(this->fd(), this->events);
+                return;
             }
-        });
+            bytes_write = 0;
+        }
+        if (bytes_write < massage.size()) {
+            if (!write_buffer_.WriteAll(massage.substr(bytes_write))) {
+                SendOverflow();
+                return;
+            }
+            this->events |= EPOLLOUT;
+            loop_.UpdateSocketContext(this->fd(), this->events);
+            WatchSendRate();
+        }
     }
 
-    void Close() override { this->loop_.RemoveSocketContext(this->fd()); }
+    // 对端长期不读取，待发送数据超出缓冲区上限，关闭连接
+    void SendOverflow() {
+        SYSTEM_LOG_WARN << "write buffer overflow, close connection: ["
+                        << fd() << "]";
+        Close();
+    }
+
+    // 出现待发送数据时开始统计发送速度，数据发送完毕后停止
+    void WatchSendRate() {
+        const auto& limits = server_.limits_;
+        if (limits.min_send_rate == 0 || send_meter_) return;
+        send_meter_ = std::make_unique<ThroughputMeter>();
+        send_meter_->Reset(ThroughputMeter::NowMsec(),
+                           limits.send_rate_window_ms);
+        ScheduleSendRateCheck();
+    }
+
+    void ScheduleSendRateCheck() {
+        const auto interval =
+            std::max<std::time_t>(server_.limits_.send_rate_window_ms / 4, 1);
+        loop_.AddTimer(interval, [self = RefPtr<Connection>(this)](auto) {
+            self->CheckSendRate();
+        });
+    }
 
-    void setHandleMassageCallback(HandleMassageCallback fun) noexcept {
-        massage_handler_ = std::move(fun);
+    void CheckSendRate() {
+        if (isClosed()) return;
+        if (write_buffer_.size() == 0) {
+            send_meter_.reset();
+            return;
+        }
+        if (send_meter_->Below(ThroughputMeter::NowMsec(),
+                               server_.limits_.min_send_rate)) {
+            SYSTEM_LOG_DEBUG << "[" << fd() << "] send rate too low, close";
+            ++server_.shed_count_;
+            Close();
+            return;
+        }
+        ScheduleSendRateCheck();
     }
 
 private:
-    HandleMassageCallback massage_handler_;
+    TcpServer& server_;
     Buffer read_buffer_;
+    bool added_{false};
+    // 只在有待发送数据时存在
+    std::unique_ptr<ThroughputMeter> send_meter_;
 };
 
 }  // namespace detail
@@ -148,18 +320,88 @@ private:
 TcpServer::TcpServer(const sockaddr_in& addr, Reactor& reactor)
     : addr_(addr), reactor_(reactor) {}
 
+void TcpServer::setConnectionLimits(const ConnectionLimits& limits) {
+    limits_ = limits;
+    accept_limiter_.reset();
+    if (limits.accept_rate.rate > 0) {
+        accept_limiter_ = std::make_unique<RateLimiter>(limits.accept_rate);
+    }
+}
+
+int TcpServer::CreateListenSocket(const sockaddr_in& addr, bool reuse_port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        SYSTEM_LOG_FATAL << "server socket create fail: " << strerror(errno);
+        throw "socket create fail";
+    }
+    int opt = 1;
+    if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt) == -1) {
+        SYSTEM_LOG_FATAL << "set reuse addr fail: [" << fd << "] "
+                         << strerror(errno);
+        ::close(fd);
+        throw "set reuse addr fail";
+    }
+    if (reuse_port &&
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof opt) == -1) {
+        SYSTEM_LOG_FATAL << "set reuse port fail: [" << fd << "] "
+                         << strerror(errno);
+        ::close(fd);
+        throw "set reuse port fail";
+    }
+    if (::bind(fd, (sockaddr*)&addr, sizeof addr) == -1) {
+        SYSTEM_LOG_FATAL << "addr bind fail: [" << fd << "] "
+                         << strerror(errno);
+        ::close(fd);
+        throw "socket addr bind fail";
+    }
+    if (::listen(fd, SOMAXCONN) == -1) {
+        SYSTEM_LOG_FATAL << "listen fail: [" << fd << "] " << strerror(errno);
+        ::close(fd);
+        throw "listen fail";
+    }
+    SYSTEM_LOG_INFO << "server listen in: " << inet_ntoa(addr.sin_addr) << ":"
+                    << ::ntohs(addr.sin_port);
+    return fd;
+}
+
 void TcpServer::StartListen() {
-    auto acceptor =
-        std::make_shared<detail::Acceptor>(reactor_.main_reactor, addr_);
+    StartListen(CreateListenSocket(addr_, reuse_port_));
+}
+
+void TcpServer::StartListen(int listen_fd) {
+    StartAccept(MakeRef<detail::Acceptor>(reactor_.main_reactor, listen_fd,
+                                          limits_.accept_retry_ms));
+}
+
+void TcpServer::StartAccept(RefPtr<detail::Acceptor> acceptor) {
     sock_fd_ = acceptor->fd();
-    acceptor->setAfterAcceptCallback([this, acceptor](int fd) {
-        auto& loop = this->reactor_.NextLoop();
-        auto conn = std::make_shared<detail::Connection>(loop, fd);
-        conn->setHandleMassageCallback(std::bind(&TcpServer::OnRecv, this,
-                                                 std::placeholders::_1,
-                                                 std::placeholders::_2));
-        this->AfterConnect(conn);
-        loop.AddSocketContext(conn);
+    // 不能捕获 acceptor 自身，否则 StopListen 之后监听 socket 永远不会关闭
+    acceptor->setAdmitCallback([this]() {
+        return limits_.max_connections == 0 ||
+               conn_count_ < limits_.max_connections;
+    });
+    acceptor->setAfterAcceptCallback([this](int fd, const sockaddr_in& peer) {
+        // 超过频率限制的客户端直接关闭，不影响其它客户端
+        if (accept_limiter_ && !accept_limiter_->Allow(peer)) {
+            ::close(fd);
+            ++shed_count_;
+            return true;
+        }
+        auto loop =
+            this->reactor_.NextLoop(&peer, limits_.max_connections_per_loop);
+        if (loop == nullptr) {
+            ::close(fd);
+            ++shed_count_;
+            return false;
+        }
+        // 在连接从 EventLoop 中移除时减少
+        ++conn_count_;
+        // 连接在所属的 EventLoop 线程中创建，之后只在该线程中增减引用计数
+        loop->CreateSocketContext(
+            [this, loop, fd, peer]() -> RefPtr<detail::SocketContext> {
+                return detail::Connection::Create(*loop, fd, peer, *this);
+            });
+        return true;
     });
     reactor_.main_reactor.AddSocketContext(std::move(acceptor));
 }
@@ -168,8 +410,10 @@ void TcpServer::StopListen() {
     reactor_.main_reactor.RemoveSocketContext(sock_fd_);
 }
 
-void TcpServer::AfterConnect(std::shared_ptr<Channel> ctx) {}
+void TcpServer::AfterConnect(const ChannelPtr& ctx) {}
+
+void TcpServer::OnRecv(const ChannelPtr& ctx, ReadBuffer& buf) {}
 
-void TcpServer::OnRecv(std::shared_ptr<Channel> ctx, ReadBuffer& buf) {}
+void TcpServer::OnClose(const ChannelPtr& ctx) {}
 
 }  // namespace skyline::core
@@ -2,38 +2,118 @@
 
 #include <netinet/in.h>
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <thread>
 
+#include "buffer.h"
+#include "channel.h"
 #include "event_loop.h"
+#include "rate_limiter.h"
 
 namespace skyline::core {
 
-class Channel;
 class Reactor;
-class ReadBuffer;
+
+namespace detail {
+
+class Acceptor;
+class Connection;
+
+}
+
+// 连接数限制与过载保护，为 0 的项不限制
+struct ConnectionLimits {
+    // 整个服务器的最大连接数，达到后暂停 accept，新连接留在监听队列中等待
+    size_t max_connections{0};
+    // 每个 EventLoop 的最大 socket 数，所选 EventLoop 已满时改选最空闲的一个，
+    // 全部已满时拒绝该连接并暂停 accept
+    size_t max_connections_per_loop{0};
+    // EventLoop 每轮事件处理耗时的滑动平均值超过该值（微秒）时视为过载
+    // 由上层协议决定如何拒绝新的工作，例如 HttpServer 直接返回 503
+    uint64_t overload_lag_usec{0};
+    // 暂停 accept 后重新尝试的间隔，单位毫秒
+    std::time_t accept_retry_ms{50};
+    // 按客户端地址限制新建连接的频率，超过的连接在 accept 后立即关闭
+    RateLimitOptions accept_rate;
+    // 有待发送数据时的最低发送速度，单位字节/秒，在 send_rate_window_ms 的
+    // 滑动窗口内统计，低于该速度（例如对端一直不读取）的连接会被关闭
+    size_t min_send_rate{0};
+    std::time_t send_rate_window_ms{10000};
+};
 
 // TcpServer 管理一个主从反应堆
-// 使用者可以根据需求重写 AfterConnect 和 OnRecv 函数
-// 这两个函数分别会在新连接建立后、收到消息时被调用
+// 使用者可以根据需求重写 AfterConnect、OnRecv 和 OnClose 函数
+// 这三个函数分别会在新连接建立后、收到消息时、连接关闭后被调用
 class TcpServer {
 public:
     TcpServer(const sockaddr_in& addr, Reactor& reactor);
     virtual ~TcpServer() = default;
 
+    // 创建、绑定并监听一个 socket，失败时抛出异常
+    // reuse_port 为 true 时设置 SO_REUSEPORT，多个进程可以各自监听同一地址
+    static int CreateListenSocket(const sockaddr_in& addr,
+                                  bool reuse_port = false);
+
     // 用户调用该函数启动服务器监听
     void StartListen();
+    // 使用已经处于监听状态的 socket，例如 ListenerHandoff 从旧进程接收的 fd
+    void StartListen(int listen_fd);
+    // 停止接收新连接并关闭监听 socket，已建立的连接不受影响
     void StopListen();
 
+    // 监听 socket，用于交接给新进程
+    int listenFd() const noexcept { return sock_fd_; }
+
+    // 由内核在多个监听同一地址的进程间分配新连接，应在 StartListen 之前设置
+    void setReusePort(bool on) noexcept { reuse_port_ = on; }
+
+    // 应在 StartListen 之前设置
+    void setConnectionLimits(const ConnectionLimits& limits);
+    const ConnectionLimits& connectionLimits() const noexcept {
+        return limits_;
+    }
+
+    // 以下统计可在任意线程读取
+    // 当前连接数（包括已接受、尚未加入 EventLoop 的连接）
+    size_t connectionCount() const noexcept { return conn_count_; }
+    // 因过载、限流或速度过低被拒绝的连接与请求数
+    uint64_t shedCount() const noexcept { return shed_count_; }
+
+    // loop 的事件处理耗时是否超过 overload_lag_usec
+    bool isOverloaded(const EventLoop& loop) const noexcept {
+        return limits_.overload_lag_usec > 0 &&
+               loop.loopLagUsec() > limits_.overload_lag_usec;
+    }
+
 protected:
     // 默认为空函数，由子类自行决定干什么
-    virtual void AfterConnect(std::shared_ptr<Channel> ctx);
-    virtual void OnRecv(std::shared_ptr<Channel> ctx, ReadBuffer& buf);
+    // 均在连接所属的 EventLoop 线程中调用，跨线程保存连接时使用 ChannelHandle
+    virtual void AfterConnect(const ChannelPtr& ctx);
+    virtual void OnRecv(const ChannelPtr& ctx, ReadBuffer& buf);
+    // 连接关闭（从 EventLoop 中移除）后调用
+    virtual void OnClose(const ChannelPtr& ctx);
+
+    Reactor& reactor() noexcept { return reactor_; }
+
+    // 子类拒绝请求时调用，计入 shedCount
+    void RecordShed() noexcept { ++shed_count_; }
+
+private:
+    friend class detail::Connection;
+
+    void StartAccept(RefPtr<detail::Acceptor> acceptor);
 
 private:
     int sock_fd_{-1};
     sockaddr_in addr_{};
+    bool reuse_port_{false};
+    ConnectionLimits limits_;
+    std::unique_ptr<RateLimiter> accept_limiter_;
+
+    std::atomic_size_t conn_count_{0};
+    std::atomic_uint64_t shed_count_{0};
 
     Reactor& reactor_;
 };
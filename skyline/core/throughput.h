@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+namespace skyline::core {
+
+// 滑动窗口内的吞吐量估计，用于发现慢速连接，非线程安全
+// 使用两个相邻的固定窗口，按当前窗口已经过的时间比例对上一个窗口加权，
+// 近似得到最近一个完整窗口内的字节数，不需要保存每次的记录
+class ThroughputMeter {
+public:
+    static std::time_t NowMsec() noexcept {
+        using namespace std::chrono;
+        return duration_cast<milliseconds>(
+                   steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // 从 now 开始重新统计，窗口长度为 window 毫秒
+    void Reset(std::time_t now, std::time_t window) noexcept {
+        start_ = now;
+        window_ = static_cast<uint32_t>(window > 0 ? window : 1);
+        prev_ = cur_ = 0;
+        warm_ = false;
+    }
+
+    void Add(std::time_t now, uint64_t bytes) noexcept {
+        Roll(now);
+        cur_ += bytes;
+    }
+
+    // 统计满一个窗口后，估计的速度低于 rate（字节/秒）时返回 true
+    bool Below(std::time_t now, uint64_t rate) noexcept {
+        Roll(now);
+        if (!warm_) return false;
+        const auto elapsed = now - start_;
+        const auto bytes = prev_ * (window_ - elapsed) / window_ + cur_;
+        return bytes * 1000 < rate * window_;
+    }
+
+private:
+    void Roll(std::time_t now) noexcept {
+        const auto windows = (now - start_) / window_;
+        if (windows <= 0) return;
+        prev_ = windows == 1 ? cur_ : 0;
+        cur_ = 0;
+        start_ += windows * window_;
+        warm_ = true;
+    }
+
+private:
+    std::time_t start_{0};  // 当前窗口的起始时间
+    uint32_t window_{1};
+    bool warm_{false};  // 是否已经统计满一个窗口
+    uint64_t prev_{0};
+    uint64_t cur_{0};
+};
+
+}  // namespace skyline::core
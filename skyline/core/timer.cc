@@ -1,5 +1,7 @@
 #include "timer.h"
 
+#include <atomic>
+
 namespace skyline::core {
 
 static std::time_t getTick() {
@@ -9,8 +11,9 @@ static std::time_t getTick() {
     return temp.count();
 }
 
+// 所有 EventLoop 的定时器共享同一个 ID 序列
 static Timer::timer_id_t getID() {
-    static Timer::timer_id_t id = 0;
+    static std::atomic<Timer::timer_id_t> id{0};
     return ++id;
 }
 
@@ -49,6 +52,7 @@ bool Timer::delTimer(timer_id_t id) {
     auto node_id = _ids.find(id);
     if (node_id == _ids.end()) return false;
     auto iter = _timers.find(node_id->second);
+    _ids.erase(node_id);
     if (iter == _timers.end()) return false;
     _timers.erase(iter);
     return true;
@@ -61,6 +65,8 @@ void Timer::checkTimer() {
         for (auto it = _timers.begin(); it != _timers.end();) {
             if (it->expire > getTick()) break;
             funcs.push_back(std::bind(std::move(it->func), it->id));
+            // 周期定时器会在执行后重新登记
+            _ids.erase(it->id);
             it = _timers.erase(it);
         }
     }
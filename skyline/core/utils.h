@@ -12,23 +12,58 @@
 #define SYSTEM_LOG_ERROR SYSTEM_LOG_LEVEL(skyline::logger::LogLevel::ERROR)
 #define SYSTEM_LOG_FATAL SYSTEM_LOG_LEVEL(skyline::logger::LogLevel::FATAL)
 
+// 限流与采样，见 SKYLINE_LOG_LIMIT 与 SKYLINE_LOG_SAMPLE
+// 可能由对端触发的日志应使用限流版本，避免日志被用来放大攻击
+#define SYSTEM_LOG_LIMIT(lv, n) \
+    SKYLINE_LOG_LIMIT(skyline::core::getSystemLogger(), lv, n)
+#define SYSTEM_LOG_SAMPLE(lv, rate) \
+    SKYLINE_LOG_SAMPLE(skyline::core::getSystemLogger(), lv, rate)
+
+#define SYSTEM_LOG_LIMIT_DEBUG(n) \
+    SYSTEM_LOG_LIMIT(skyline::logger::LogLevel::DEBUG, n)
+#define SYSTEM_LOG_LIMIT_INFO(n) \
+    SYSTEM_LOG_LIMIT(skyline::logger::LogLevel::INFO, n)
+#define SYSTEM_LOG_LIMIT_WARN(n) \
+    SYSTEM_LOG_LIMIT(skyline::logger::LogLevel::WARN, n)
+#define SYSTEM_LOG_LIMIT_ERROR(n) \
+    SYSTEM_LOG_LIMIT(skyline::logger::LogLevel::ERROR, n)
+#define SYSTEM_LOG_LIMIT_FATAL(n) \
+    SYSTEM_LOG_LIMIT(skyline::logger::LogLevel::FATAL, n)
+
 namespace skyline::core {
 
 logger::Logger& getSystemLogger();
 std::shared_ptr<logger::LogAppender> getSafeStdoutAppender();
 
 template <typename... Args>
-void SYSTEM_LOG_FMT(skyline::logger::LogLevel level, const char* fmt,
-                    Args&&... args) {
+void SYSTEM_LOG_FMT(skyline::logger::LogLevel level,
+                    skyline::logger::LogPrintfString fmt, Args&&... args) {
     skyline::logger::LOG_FMT(getSystemLogger(), level, fmt, args...);
 }
 
 #define _FUNCTION(name)                                                \
     template <typename... Args>                                        \
-    void SYSTEM_LOG_FMT_##name(const char* fmt, Args&&... args) {      \
+    void SYSTEM_LOG_FMT_##name(skyline::logger::LogPrintfString fmt,   \
+                               Args&&... args) {                       \
         SYSTEM_LOG_FMT(skyline::logger::LogLevel::name, fmt, args...); \
     }
 FOREACH_LOG_LEVEL(_FUNCTION)
 #undef _FUNCTION
 
+template <typename... Args>
+void SYSTEM_LOG_FORMAT(skyline::logger::LogLevel level,
+                       skyline::logger::LogFormatString<Args...> fmt,
+                       const Args&... args) {
+    skyline::logger::LOG_FORMAT(getSystemLogger(), level, fmt, args...);
+}
+
+#define _FUNCTION(name)                                                   \
+    template <typename... Args>                                           \
+    void SYSTEM_LOG_FORMAT_##name(                                        \
+        skyline::logger::LogFormatString<Args...> fmt, const Args&... args) { \
+        SYSTEM_LOG_FORMAT(skyline::logger::LogLevel::name, fmt, args...); \
+    }
+FOREACH_LOG_LEVEL(_FUNCTION)
+#undef _FUNCTION
+
 }  // namespace skyline::core
@@ -0,0 +1,270 @@
+#include "access_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include "core/utils.h"
+#include "logger/json_log.h"
+
+namespace skyline::http {
+
+namespace {
+
+// 记录格式：RecordHeader | path | query | referer | user-agent
+struct RecordHeader {
+    uint32_t size;  // 整条记录的长度
+    uint16_t path_len;
+    uint16_t query_len;
+    uint16_t referer_len;
+    uint16_t agent_len;
+    uint32_t latency_us;
+    int64_t time;
+    uint64_t bytes;
+    uint32_t peer_ip;
+    uint16_t peer_port;
+    uint16_t status;
+    uint8_t version;
+    uint8_t method;
+};
+
+}  // namespace
+
+static constexpr size_t kMaxRecordSize =
+    sizeof(RecordHeader) + 4 * AccessLog::kMaxFieldLength;
+
+// CLF 中引号、反斜杠和控制字符的转义，与 JSON 使用相同的向量化扫描
+static void appendEscaped(std::string& out, std::string_view s) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    size_t begin = 0;
+    while (true) {
+        const auto pos = logger::detail::findEscape(s.data(), begin, s.size());
+        out.append(s.data() + begin, pos - begin);
+        if (pos == s.size()) break;
+        const auto c = static_cast<unsigned char>(s[pos]);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else {
+            out.append("\\x");
+            out += kHex[c >> 4];
+            out += kHex[c & 0xf];
+        }
+        begin = pos + 1;
+    }
+}
+
+// 空字段在 CLF 中输出为 -
+static void appendQuoted(std::string& out, std::string_view s) {
+    out += '"';
+    if (s.empty()) {
+        out += '-';
+    } else {
+        appendEscaped(out, s);
+    }
+    out += '"';
+}
+
+static void appendAddress(std::string& out, const sockaddr_in& addr) {
+    const auto ip = ntohl(addr.sin_addr.s_addr);
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        logger::detail::appendNumber(out, (ip >> shift) & 0xff);
+        if (shift > 0) out += '.';
+    }
+}
+
+static void appendProtocol(std::string& out, uint8_t version) {
+    out.append("HTTP/");
+    out += static_cast<char>('0' + (version >> 4));
+    out += '.';
+    out += static_cast<char>('0' + (version & 0xf));
+}
+
+// 同一秒内的记录复用格式化好的时间
+struct TimeCache {
+    time_t sec{-1};
+    char clf[32];  // 18/Oct/2026:12:00:00 +0800
+    char iso[32];  // 2026-10-18T12:00:00
+    char zone[8];  // +08:00
+};
+
+static const TimeCache& formatTime(int64_t time_ns) {
+    static thread_local TimeCache cache;
+    const time_t sec = time_ns / 1000000000;
+    if (cache.sec != sec) {
+        std::tm tm;
+        localtime_r(&sec, &tm);
+        std::strftime(cache.clf, sizeof cache.clf, "%d/%b/%Y:%H:%M:%S %z", &tm);
+        std::strftime(cache.iso, sizeof cache.iso, "%Y-%m-%dT%H:%M:%S", &tm);
+        const auto offset = tm.tm_gmtoff / 60;
+        const auto abs = offset < 0 ? -offset : offset;
+        std::snprintf(cache.zone, sizeof cache.zone, "%c%02ld:%02ld",
+                      offset < 0 ? '-' : '+', abs / 60, abs % 60);
+        cache.sec = sec;
+    }
+    return cache;
+}
+
+// ---------------------------- AccessLog ----------------------------
+
+AccessLog::AccessLog(const AccessLogOptions& options)
+    : format_(options.format), file_(options.filename, options.file) {
+    rings_.setRingCapacity(options.ring_capacity);
+    rings_.setFullPolicy(logger::RingFullPolicy::DROP_COUNTED);
+    thread_ = std::thread([this]() { Run(); });
+}
+
+AccessLog::~AccessLog() {
+    rings_.close();
+    thread_.join();
+}
+
+void AccessLog::Record(const AccessLogEntry& entry) {
+    static thread_local char buf[kMaxRecordSize];
+    char* p = buf + sizeof(RecordHeader);
+    auto put = [&p](std::string_view s) {
+        const auto n = std::min(s.size(), kMaxFieldLength);
+        std::memcpy(p, s.data(), n);
+        p += n;
+        return static_cast<uint16_t>(n);
+    };
+    RecordHeader header{
+        .path_len = put(entry.path),
+        .query_len = put(entry.query),
+        .referer_len = put(entry.referer),
+        .agent_len = put(entry.user_agent),
+        .latency_us = entry.latency_us,
+        .time = entry.time,
+        .bytes = entry.bytes,
+        .peer_ip = entry.peer.sin_addr.s_addr,
+        .peer_port = entry.peer.sin_port,
+        .status = entry.status,
+        .version = entry.version,
+        .method = static_cast<uint8_t>(entry.method),
+    };
+    header.size = static_cast<uint32_t>(p - buf);
+    std::memcpy(buf, &header, sizeof header);
+    rings_.push({buf, header.size});
+}
+
+void AccessLog::Run() {
+    auto on_dropped = [](uint64_t n, uint32_t thread_id) {
+        core::SYSTEM_LOG_FMT_WARN("%lu access log records dropped by thread %u",
+                                  n, thread_id);
+    };
+    rings_.run([&](std::string_view data) { pending_.append(data); },
+               on_dropped, [&](bool) {
+                   if (pending_.empty()) return;
+                   Process(pending_);
+                   pending_.clear();
+                   file_.write(out_.data(), out_.size());
+                   file_.sync();
+                   out_.clear();
+               });
+}
+
+void AccessLog::Process(std::string_view records) {
+    while (records.size() >= sizeof(RecordHeader)) {
+        RecordHeader header;
+        std::memcpy(&header, records.data(), sizeof header);
+        if (header.size < sizeof header || header.size > records.size()) break;
+
+        AccessLogEntry entry{
+            .time = header.time,
+            .latency_us = header.latency_us,
+            .status = header.status,
+            .version = header.version,
+            .method = static_cast<HttpMethod>(header.method),
+            .bytes = header.bytes,
+        };
+        entry.peer.sin_addr.s_addr = header.peer_ip;
+        entry.peer.sin_port = header.peer_port;
+        auto strings = records.substr(sizeof header);
+        auto take = [&strings](uint16_t len) {
+            auto s = strings.substr(0, len);
+            strings.remove_prefix(s.size());
+            return s;
+        };
+        entry.path = take(header.path_len);
+        entry.query = take(header.query_len);
+        entry.referer = take(header.referer_len);
+        entry.user_agent = take(header.agent_len);
+        records.remove_prefix(header.size);
+
+        Format(out_, format_, entry);
+    }
+}
+
+void AccessLog::Format(std::string& out, AccessLogFormat format,
+                       const AccessLogEntry& entry) {
+    using logger::detail::appendNumber;
+    const auto& time = formatTime(entry.time);
+    const char* method = httpMethod2String(entry.method);
+
+    if (format == AccessLogFormat::JSON) {
+        out.append("{\"time\":\"");
+        out.append(time.iso);
+        out += '.';
+        const auto ms = entry.time / 1000000 % 1000;
+        out += static_cast<char>('0' + ms / 100);
+        out += static_cast<char>('0' + ms / 10 % 10);
+        out += static_cast<char>('0' + ms % 10);
+        out.append(time.zone);
+        out.append("\",\"remote_addr\":\"");
+        appendAddress(out, entry.peer);
+        out.append("\",\"remote_port\":");
+        appendNumber(out, ntohs(entry.peer.sin_port));
+        out.append(",\"method\":\"");
+        if (method != nullptr) out.append(method);
+        out.append("\",\"path\":\"");
+        logger::detail::appendJsonEscaped(out, entry.path);
+        out.append("\",\"query\":\"");
+        logger::detail::appendJsonEscaped(out, entry.query);
+        out.append("\",\"protocol\":\"");
+        appendProtocol(out, entry.version);
+        out.append("\",\"status\":");
+        appendNumber(out, entry.status);
+        out.append(",\"bytes\":");
+        appendNumber(out, entry.bytes);
+        out.append(",\"latency_us\":");
+        appendNumber(out, entry.latency_us);
+        out.append(",\"referer\":\"");
+        logger::detail::appendJsonEscaped(out, entry.referer);
+        out.append("\",\"user_agent\":\"");
+        logger::detail::appendJsonEscaped(out, entry.user_agent);
+        out.append("\"}\n");
+        return;
+    }
+
+    appendAddress(out, entry.peer);
+    out.append(" - - [");
+    out.append(time.clf);
+    out.append("] \"");
+    if (method == nullptr) {
+        // 请求未解析完成
+        out += '-';
+    } else {
+        out.append(method);
+        out += ' ';
+        appendEscaped(out, entry.path);
+        if (!entry.query.empty()) {
+            out += '?';
+            appendEscaped(out, entry.query);
+        }
+        out += ' ';
+        appendProtocol(out, entry.version);
+    }
+    out.append("\" ");
+    appendNumber(out, entry.status);
+    out += ' ';
+    appendNumber(out, entry.bytes);
+    if (format == AccessLogFormat::COMBINED) {
+        out += ' ';
+        appendQuoted(out, entry.referer);
+        out += ' ';
+        appendQuoted(out, entry.user_agent);
+    }
+    out += '\n';
+}
+
+}  // namespace skyline::http
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "http.h"
+#include "logger/log_file.h"
+#include "logger/log_ring.h"
+
+namespace skyline::http {
+
+enum class AccessLogFormat {
+    // host - - [time] "request" status bytes
+    COMMON,
+    // COMMON 之后加上 "referer" "user-agent"
+    COMBINED,
+    // 每行一个 JSON 对象，另外包含毫秒时间、端口和处理耗时
+    JSON,
+};
+
+struct AccessLogOptions {
+    std::string filename;  // 为空时不记录访问日志
+    AccessLogFormat format{AccessLogFormat::COMBINED};
+    logger::LogFileOptions file;
+    // 每个反应堆线程的缓冲区大小，写满时丢弃并计数，不阻塞反应堆
+    size_t ring_capacity{1 << 22};
+};
+
+// 一次请求的访问记录，由反应堆线程填写，字符串只在 Record 期间被引用
+struct AccessLogEntry {
+    int64_t time{0};        // 开始处理请求的时间，纳秒
+    uint32_t latency_us{0};  // 从开始处理到响应完成的耗时
+    uint16_t status{0};
+    uint8_t version{0x11};
+    HttpMethod method{HttpMethod::INVALID_METHOD};  // 请求未解析完成时无效
+    sockaddr_in peer{};
+    uint64_t bytes{0};  // 响应的总字节数，包括状态行和响应头
+    std::string_view path;
+    std::string_view query;
+    std::string_view referer;
+    std::string_view user_agent;
+};
+
+// 访问日志：反应堆线程只把定长的记录头和引用的字符串复制到本线程的环形缓冲区，
+// 不加锁、不格式化；后台线程取走所有记录，格式化后一次写入文件
+class AccessLog {
+public:
+    // 单个字符串字段的最大长度，超出部分被截断
+    static constexpr size_t kMaxFieldLength = 2048;
+
+    explicit AccessLog(const AccessLogOptions& options);
+    AccessLog(const AccessLog&) = delete;
+    // 写出剩余的记录
+    ~AccessLog();
+
+    void Record(const AccessLogEntry& entry);
+
+    // 缓冲区写满而丢弃的记录数
+    uint64_t droppedCount() const noexcept { return rings_.droppedCount(); }
+
+    // 按 format 格式化一条记录，追加到 out，包括换行
+    static void Format(std::string& out, AccessLogFormat format,
+                       const AccessLogEntry& entry);
+
+private:
+    void Run();
+    void Process(std::string_view records);
+
+private:
+    const AccessLogFormat format_;
+    logger::LogFile file_;
+    logger::LogRingSet rings_;
+    std::string pending_;  // 取出的记录
+    std::string out_;      // 格式化的结果
+    std::thread thread_;
+};
+
+}  // namespace skyline::http
@@ -6,12 +6,15 @@
 
 namespace skyline::http {
 
+// 解析错误由对端触发，限制每个调用处每秒输出的条数
+static constexpr uint32_t kInvalidLogLimit = 10;
+
 static void on_request_method(void *data, const char *at, size_t length) {
     HttpRequestParser *parser = reinterpret_cast<HttpRequestParser *>(data);
     auto m = string2HttpMethod(std::string_view(at, length));
     if (m == HttpMethod::INVALID_METHOD) {
-        SYSTEM_LOG_WARN << "invalid http request method "
-                        << std::string_view(at, length);
+        SYSTEM_LOG_LIMIT_WARN(kInvalidLogLimit)
+            << "invalid http request method " << std::string_view(at, length);
         parser->setError(1000);
     }
     parser->data().method = m;
@@ -38,8 +41,8 @@ static void on_request_version(void *data, const char *at, size_t length) {
     } else if (::strncmp(at, "HTTP/1.0", length) == 0) {
         v = 0x10;
     } else {
-        SYSTEM_LOG_WARN << "invalid http request version: "
-                        << std::string_view(at, length);
+        SYSTEM_LOG_LIMIT_WARN(kInvalidLogLimit)
+            << "invalid http request version: " << std::string_view(at, length);
         parser->setError(1001);
         return;
     }
@@ -51,7 +54,8 @@ static void on_request_http_field(void *data, const char *field, size_t flen,
                                   const char *value, size_t vlen) {
     HttpRequestParser *parser = reinterpret_cast<HttpRequestParser *>(data);
     if (flen == 0) {
-        SYSTEM_LOG_WARN << "invalid http request field length == 0";
+        SYSTEM_LOG_LIMIT_WARN(kInvalidLogLimit)
+            << "invalid http request field length == 0";
         parser->setError(1002);
         return;
     }
@@ -62,6 +66,18 @@ static void on_request_http_field(void *data, const char *field, size_t flen,
             parser->data().close = false;
         }
     }
+    // 重复且不一致的 Content-Length 无法确定请求的边界，流水线请求会错位
+    if (flen == 14 && ::strncasecmp(field, "content-length", 14) == 0) {
+        auto old = parser->data().getHeader("content-length");
+        if (old != nullptr && *old != std::string_view(value, vlen)) {
+            SYSTEM_LOG_LIMIT_WARN(kInvalidLogLimit)
+                << "conflicting http request content-length " << *old
+                << " and " << std::string_view(value, vlen);
+            parser->setError(1004);
+            return;
+        }
+    }
+    parser->addField();
     parser->data().setHeader(std::string(field, flen),
                              std::string(value, vlen));
 }
@@ -83,15 +99,32 @@ size_t HttpRequestParser::execute(const char *buffer, size_t len, size_t off) {
     if (off > len) {
         SYSTEM_LOG_WARN << "http parse acquire offset <= len";
         setError(1003);
-        return _parser.nread;
+        return 0;
     }
     auto p = buffer + off;
     auto pe = buffer + len - 1;
     while (*pe != '\n' && pe > p) {
         --pe;
     }
-    if (p == pe) return _parser.nread;
-    return http_parser_execute(&_parser, buffer, pe + 1 - buffer, off);
+    if (p == pe) return 0;
+    // 调用方会丢弃已解析的数据，因此相对缓冲区的偏移需要每次重新计算
+    // 由于只投喂完整的行，上一次调用留下的标记不会跨越本次调用
+    _parser.nread = 0;
+    _parser.mark = 0;
+    _parser.field_start = 0;
+    _parser.field_len = 0;
+    _parser.query_start = 0;
+    auto nparsed = http_parser_execute(&_parser, buffer, pe + 1 - buffer, off);
+    _header_bytes += nparsed;
+    return nparsed;
+}
+
+void HttpRequestParser::reset() {
+    http_parser_init(&_parser);
+    _data = HttpRequest();
+    _error = 0;
+    _field_count = 0;
+    _header_bytes = 0;
 }
 
 int HttpRequestParser::isFinished() {
@@ -120,8 +153,9 @@ static void on_response_version(void *data, const char *at, size_t length) {
     } else if (::strncmp(at, "HTTP/1.0", length) == 0) {
         v = 0x10;
     } else {
-        SYSTEM_LOG_WARN << "invalid http response version: "
-                        << std::string_view(at, length);
+        SYSTEM_LOG_LIMIT_WARN(kInvalidLogLimit)
+            << "invalid http response version: "
+            << std::string_view(at, length);
         parser->setError(1001);
         return;
     }
@@ -135,7 +169,8 @@ static void on_response_http_field(void *data, const char *field, size_t flen,
                                    const char *value, size_t vlen) {
     HttpResponseParser *parser = reinterpret_cast<HttpResponseParser *>(data);
     if (flen == 0) {
-        SYSTEM_LOG_WARN << "invalid http response field length == 0";
+        SYSTEM_LOG_LIMIT_WARN(kInvalidLogLimit)
+            << "invalid http response field length == 0";
         parser->setError(1002);
         return;
     }
@@ -10,17 +10,28 @@ class HttpRequestParser {
 public:
     HttpRequestParser();
 
+    // 只解析到最后一个完整的行，返回本次调用消耗的字节数
     size_t execute(const char* buffer, size_t len, size_t off);
     int isFinished();
     int hasError();
 
+    // 重置解析状态，用于同一连接上解析下一个请求
+    void reset();
+
     HttpRequest& data() { return _data; }
     void setError(int e) { _error = e; }
 
+    // 当前请求已解析的请求头字段数与字节数（包括请求行），用于限制请求头大小
+    size_t fieldCount() const { return _field_count; }
+    size_t headerBytes() const { return _header_bytes; }
+    void addField() { ++_field_count; }
+
 private:
     http_parser _parser{};
     HttpRequest _data;
     int _error{};
+    size_t _field_count{};
+    size_t _header_bytes{};
 };
 
 class HttpResponseParser {
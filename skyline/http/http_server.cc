@@ -1,69 +1,327 @@
 #include "http_server.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <sstream>
 
 #include "core/buffer.h"
 #include "core/channel.h"
+#include "core/reactor.h"
+#include "core/utils.h"
 #include "http_session.h"
 
+// 过载时返回的固定响应，不经过解析和路由
+static constexpr std::string_view kOverloadedResponse =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Length: 0\r\n"
+    "Retry-After: 1\r\n"
+    "Connection: close\r\n\r\n";
+
 namespace skyline::http {
 
+// 只有状态行的错误响应，发送后关闭连接
+static std::string ErrorResponse(HttpStatus status) {
+    HttpResponse res(0x11, true);
+    res.status = status;
+    std::stringstream ss;
+    ss << res;
+    return ss.str();
+}
+
+HttpServer::HttpServer(const sockaddr_in& addr, core::Reactor& reactor)
+    : TcpServer(addr, reactor), loop_sessions_(reactor.loopCount()) {}
+
 // 新连接创建之后，为其创建一个新会话，并添加一个关闭定时器
-void HttpServer::AfterConnect(std::shared_ptr<core::Channel> ctx) {
-    http_sessions_[ctx->fd()] = std::make_shared<HttpSession>();
-    http_sessions_[ctx->fd()]->timer_id =
-        ctx->loop().AddTimer(500, [this, ctx](auto) {
-            http_sessions_[ctx->fd()].reset();
-            ctx->Close();
-        });
+void HttpServer::AfterConnect(const core::ChannelPtr& ctx) {
+    auto session = std::make_shared<HttpSession>(request_limits);
+    LoopSessions(ctx->loop())[ctx->fd()] = {session, core::ChannelHandle(ctx)};
+    ++session_count_;
+    AddIdleTimer(ctx, session);
 }
 
-void HttpServer::OnRecv(std::shared_ptr<core::Channel> ctx,
-                        core::ReadBuffer& buf) {
+void HttpServer::OnRecv(const core::ChannelPtr& ctx, core::ReadBuffer& buf) {
     // 拿到对应的会话
-    auto cur_session = http_sessions_[ctx->fd()];
-    // 解析数据
-    cur_session->Parse(buf.ReadAll());
-    // 解析错误，移除定时器，销毁会话，关闭连接
-    if (cur_session->isError()) {
-        if (cur_session->timer_id) {
-            ctx->loop().RemoveTimer(*cur_session->timer_id);
+    auto session = GetSession(ctx);
+    if (!session) return;
+    // 过载时在解析之前拒绝新的请求，已在途的请求仍正常完成
+    if (session->inflight() == 0 && isOverloaded(ctx->loop())) {
+        buf.Retrieve(buf.size());
+        RecordShed();
+        ctx->SendMassage(kOverloadedResponse);
+        if (access_log_) {
+            RecordAccess(ctx, nullptr,
+                         HttpStatus::HTTP_STATUS_SERVICE_UNAVAILABLE,
+                         kOverloadedResponse.size(),
+                         std::chrono::steady_clock::now());
         }
-        http_sessions_[ctx->fd()].reset();
-        ctx->Close();
+        CloseSession(ctx, session);
         return;
     }
-    // 获取解析完的请求
-    auto req = cur_session->TryGet();
-    // 未解析完，直接返回，等待下次消息继续解析
-    if (!req) return;
-    // 创建 response
-    HttpResponse res(req->version, req->close || !is_keepalive);
-    // 由路径分发器填充 response
-    dispatch.handle(*req.get(), res, ctx);
-    // 将 response 转为字符串并发送
-    std::stringstream ss;
-    ss << res;
-    std::string data = ss.str();
-    ctx->SendMassage(data);
-    // 一次交流结束，移除定时器
-    if (cur_session->timer_id) {
-        ctx->loop().RemoveTimer(*cur_session->timer_id);
+    // 追加数据，解析并分发所有完整的请求
+    session->Parse(buf.ReadAll());
+    ProcessRequests(ctx, session);
+}
+
+// 对端关闭或出错，连接已被移除，清理会话
+void HttpServer::OnClose(const core::ChannelPtr& ctx) {
+    if (auto session = GetSession(ctx); session && !session->isClosed()) {
+        CloseSession(ctx, session);
+    }
+}
+
+HttpServer::SessionMap& HttpServer::LoopSessions(
+    const core::EventLoop& loop) noexcept {
+    return loop_sessions_[reactor().loopIndex(loop)];
+}
+
+HttpServer::SessionPtr HttpServer::GetSession(const core::ChannelPtr& ctx) {
+    auto& sessions = LoopSessions(ctx->loop());
+    auto it = sessions.find(ctx->fd());
+    return it == sessions.end() ? nullptr : it->second.session;
+}
+
+void HttpServer::ProcessRequests(const core::ChannelPtr& ctx,
+                                 const SessionPtr& session) {
+    // 在途请求过多时暂停分发和读取，剩余数据留在会话和内核缓冲区中，
+    // 等响应发出后继续；未暂停时，对端的数据只能是一个未接收完的请求，
+    // 其大小由 request_limits 限制
+    while (!session->isClosed()) {
+        if (session->inflight() >= max_inflight) {
+            ctx->PauseRead();
+            return;
+        }
+        auto req = session->TryGet();
+        // 解析错误或超出限制，返回错误状态后关闭连接
+        // 之前的请求还未响应时无法保证顺序，直接关闭
+        if (session->isError()) {
+            if (session->inflight() == 0) {
+                auto res = ErrorResponse(session->error());
+                ctx->SendMassage(res);
+                if (access_log_) {
+                    RecordAccess(ctx, nullptr, session->error(), res.size(),
+                                 std::chrono::steady_clock::now());
+                }
+            }
+            CloseSession(ctx, session);
+            return;
+        }
+        // 未解析完，等待下次消息继续解析
+        // 有在途请求时，不再缓存超过 max_pipeline_bytes 的后续数据
+        if (!req) {
+            const auto limit = request_limits.max_pipeline_bytes;
+            if (session->inflight() > 0 && limit > 0 &&
+                session->buffered() > limit) {
+                ctx->PauseRead();
+            } else {
+                ctx->ResumeRead();
+            }
+            return;
+        }
+        // 该响应发出后连接就会关闭，之后流水线上的请求不再处理，也不再读取
+        if (DispatchRequest(ctx, session, std::move(req))) {
+            ctx->PauseRead();
+            return;
+        }
+    }
+}
+
+bool HttpServer::DispatchRequest(const core::ChannelPtr& ctx,
+                                 const SessionPtr& session,
+                                 std::unique_ptr<HttpRequest> req) {
+    // 有请求在途，空闲定时器不再生效
+    RemoveIdleTimer(ctx->loop(), session);
+    auto seq = session->Enqueue();
+    // 创建 response，退出过程中的请求处理完毕后关闭连接
+    const bool close = req->close || !is_keepalive || draining_;
+    HttpResponse res(req->version, close);
+    const auto start = access_log_ ? std::chrono::steady_clock::now()
+                                   : std::chrono::steady_clock::time_point{};
+    // 完成回调总是在连接所属的 EventLoop 中执行
+    // 但 completion 可能在其它线程中析构，因此通过句柄持有连接
+    HttpCompletion completion(
+        ctx->loop(), std::move(req), std::move(res),
+        [this, handle = core::ChannelHandle(ctx), session, seq,
+         start](const HttpRequest& req, HttpResponse&& res) {
+            if (session->isClosed()) return;
+            auto ctx = handle.get();
+            // 将 response 转为字符串，等待按序发送
+            std::stringstream ss;
+            ss << res;
+            auto data = ss.str();
+            if (access_log_) {
+                RecordAccess(ctx, &req, res.status, data.size(), start);
+            }
+            session->Complete(seq, std::move(data), res.close);
+            FlushResponses(ctx, session);
+        });
+    // 超过频率限制的请求同样按序响应，不影响流水线上的其它请求
+    if (request_limiter_ && !request_limiter_->Allow(ctx->peerAddr())) {
+        RecordShed();
+        auto& res = completion.response();
+        res.status = HttpStatus::HTTP_STATUS_TOO_MANY_REQUESTS;
+        res.setHeader("Retry-After", "1");
+        completion.complete();
+        return close;
+    }
+    // 由路径分发器填充 response，可能稍后才完成
+    dispatch.handleAsync(completion.request(), completion, ctx);
+    return close;
+}
+
+void HttpServer::FlushResponses(const core::ChannelPtr& ctx,
+                                const SessionPtr& session) {
+    std::string data;
+    bool close = false;
+    bool sent = false;
+    while (session->TryPop(data, close)) {
+        ctx->SendMassage(data);
+        sent = true;
+        // 短连接，直接关闭，丢弃之后的请求
+        if (close) {
+            CloseSession(ctx, session);
+            return;
+        }
     }
-    // 如果是长连接，重新初始化会话，重新添加定时器
-    if (is_keepalive && !req->close) {
-        http_sessions_[ctx->fd()] = std::make_shared<HttpSession>();
-        http_sessions_[ctx->fd()]->timer_id =
-            ctx->loop().AddTimer(500, [this, &ctx](auto) {
-                this->http_sessions_[ctx->fd()].reset();
-                ctx->Close();
-            });
-    } else {
-        // 短连接，直接关闭
-        this->http_sessions_[ctx->fd()].reset();
-        ctx->Close();
+    if (!sent) return;
+    // 继续处理因在途请求数限制而积压的请求
+    ProcessRequests(ctx, session);
+    // 如果是长连接且没有在途请求，重新添加定时器；退出过程中直接关闭
+    if (!session->isClosed() && session->inflight() == 0) {
+        if (draining_) {
+            CloseSession(ctx, session);
+        } else {
+            AddIdleTimer(ctx, session);
+        }
+    }
+}
+
+void HttpServer::AddIdleTimer(const core::ChannelPtr& ctx,
+                              const SessionPtr& session) {
+    if (session->timer_id) return;
+    session->timer_id = ctx->loop().AddTimer(
+        idle_timeout,
+        [this, ctx, session](auto) {
+            session->timer_id.reset();
+            CloseSession(ctx, session);
+        });
+}
+
+void HttpServer::RemoveIdleTimer(core::EventLoop& loop,
+                                 const SessionPtr& session) {
+    if (session->timer_id) {
+        loop.RemoveTimer(*session->timer_id);
+        session->timer_id.reset();
+    }
+}
+
+void HttpServer::CloseSession(const core::ChannelPtr& ctx,
+                              const SessionPtr& session) {
+    session->close();
+    // fd 可能已被新连接复用，只移除属于自己的会话
+    auto& sessions = LoopSessions(ctx->loop());
+    auto it = sessions.find(ctx->fd());
+    if (it != sessions.end() && it->second.session == session) {
+        sessions.erase(it);
+        // 先减少计数再检查 draining_，与 Shutdown 的顺序相反，
+        // 两者至少有一方会看到退出已完成
+        if (--session_count_ == 0 && draining_) {
+            reactor().main_reactor.RunInLoop([this]() { FinishDrain(); });
+        }
+    }
+    RemoveIdleTimer(ctx->loop(), session);
+    ctx->Close();
+}
+
+void HttpServer::setRequestRateLimit(const core::RateLimitOptions& options) {
+    request_limiter_.reset();
+    if (options.rate > 0) {
+        request_limiter_ = std::make_unique<core::RateLimiter>(options);
+    }
+}
+
+void HttpServer::setAccessLog(const AccessLogOptions& options) {
+    access_log_.reset();
+    if (!options.filename.empty()) {
+        access_log_ = std::make_unique<AccessLog>(options);
+    }
+}
+
+void HttpServer::RecordAccess(const core::ChannelPtr& ctx,
+                              const HttpRequest* req, HttpStatus status,
+                              size_t bytes,
+                              std::chrono::steady_clock::time_point start) {
+    using namespace std::chrono;
+    const auto latency =
+        duration_cast<nanoseconds>(steady_clock::now() - start);
+    AccessLogEntry entry{
+        // 墙上时间只用于记录开始处理的时刻
+        .time = duration_cast<nanoseconds>(
+                    system_clock::now().time_since_epoch() - latency)
+                    .count(),
+        .latency_us =
+            static_cast<uint32_t>(duration_cast<microseconds>(latency).count()),
+        .status = static_cast<uint16_t>(status),
+        .peer = ctx->peerAddr(),
+        .bytes = bytes,
+    };
+    if (req != nullptr) {
+        entry.version = req->version;
+        entry.method = req->method;
+        entry.path = req->path;
+        entry.query = req->query;
+        if (auto v = req->getHeader("referer")) entry.referer = *v;
+        if (auto v = req->getHeader("user-agent")) entry.user_agent = *v;
+    }
+    access_log_->Record(entry);
+}
+
+void HttpServer::Shutdown(std::time_t timeout,
+                          std::function<void()> on_drained) {
+    {
+        std::lock_guard lock(drain_mtx_);
+        if (draining_) return;
+        on_drained_ = std::move(on_drained);
+        draining_ = true;
     }
+    SYSTEM_LOG_INFO << "http server draining, timeout " << timeout << "ms";
+    // 新连接留在监听队列中，交由接管监听 socket 的新进程处理
+    StopListen();
+    CloseSessions(false);
+    auto& loop = reactor().main_reactor;
+    loop.RunInLoop([this, &loop, timeout]() {
+        loop.AddTimer(timeout, [this](auto) {
+            if (drained_) return;
+            SYSTEM_LOG_WARN << "http server drain timeout, force close";
+            CloseSessions(true);
+            FinishDrain();
+        });
+        if (session_count_ == 0) FinishDrain();
+    });
+}
+
+void HttpServer::CloseSessions(bool force) {
+    for (size_t i = 0; i < loop_sessions_.size(); ++i) {
+        reactor().loopAt(i).RunInLoop([this, i, force]() {
+            // CloseSession 会修改会话表，先复制一份
+            std::vector<SessionEntry> entries;
+            for (auto& [fd, entry] : loop_sessions_[i]) {
+                entries.push_back(entry);
+            }
+            for (auto& [session, channel] : entries) {
+                if (session->isClosed()) continue;
+                if (force || session->inflight() == 0) {
+                    CloseSession(channel.get(), session);
+                }
+            }
+        });
+    }
+}
+
+void HttpServer::FinishDrain() {
+    if (drained_.exchange(true)) return;
+    SYSTEM_LOG_INFO << "http server drained";
+    if (on_drained_) on_drained_();
 }
 
 }  // namespace skyline::http
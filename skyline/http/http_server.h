@@ -1,28 +1,111 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "access_log.h"
 #include "core/tcp_server.h"
+#include "http_session.h"
 #include "servlet.h"
 
 namespace skyline::http {
 
-class HttpSession;
-
 using skyline::core::TcpServer;
 
 class HttpServer : public TcpServer {
 public:
-    using TcpServer::TcpServer;
+    HttpServer(const sockaddr_in& addr, core::Reactor& reactor);
+
+    void AfterConnect(const core::ChannelPtr& ctx) override;
+
+    void OnRecv(const core::ChannelPtr& ctx, core::ReadBuffer& buf) override;
+
+    void OnClose(const core::ChannelPtr& ctx) override;
+
+    // 优雅退出：停止监听并关闭空闲连接，在途请求完成后以 Connection: close
+    // 响应并关闭连接。所有连接关闭或超过 timeout 毫秒（强制关闭剩余连接）后，
+    // 在主反应堆中调用 on_drained。可在任意线程调用，只有第一次调用生效
+    void Shutdown(std::time_t timeout, std::function<void()> on_drained);
+
+    bool isDraining() const noexcept { return draining_; }
+
+    // 按客户端地址限制请求频率，超过的请求直接以 429 响应，不经过路由
+    // 应在 StartListen 之前设置，rate 为 0 时关闭
+    void setRequestRateLimit(const core::RateLimitOptions& options);
+
+    // 记录访问日志，反应堆线程只写入定长的二进制记录，由后台线程格式化写出
+    // 应在 StartListen 之前设置，filename 为空时关闭
+    void setAccessLog(const AccessLogOptions& options);
 
-    void AfterConnect(std::shared_ptr<core::Channel> ctx) override;
+private:
+    using SessionPtr = std::shared_ptr<HttpSession>;
 
-    void OnRecv(std::shared_ptr<core::Channel> ctx,
-                core::ReadBuffer& buf) override;
+    struct SessionEntry {
+        SessionPtr session;
+        // 用于退出时关闭连接
+        core::ChannelHandle channel;
+    };
+    // fd -> session，只在所属 EventLoop 线程中访问
+    using SessionMap = std::unordered_map<int, SessionEntry>;
+
+    SessionMap& LoopSessions(const core::EventLoop& loop) noexcept;
+    SessionPtr GetSession(const core::ChannelPtr& ctx);
+
+    // 在会话允许的在途请求数内，分发所有已解析完毕的请求
+    void ProcessRequests(const core::ChannelPtr& ctx,
+                         const SessionPtr& session);
+    // 返回该请求的响应是否会关闭连接
+    bool DispatchRequest(const core::ChannelPtr& ctx,
+                         const SessionPtr& session,
+                         std::unique_ptr<HttpRequest> req);
+    // 按请求顺序发送已完成的响应
+    void FlushResponses(const core::ChannelPtr& ctx,
+                        const SessionPtr& session);
+
+    // 空闲超时定时器，只在没有在途请求时生效
+    void AddIdleTimer(const core::ChannelPtr& ctx,
+                      const SessionPtr& session);
+    void RemoveIdleTimer(core::EventLoop& loop, const SessionPtr& session);
+
+    void CloseSession(const core::ChannelPtr& ctx, const SessionPtr& session);
+
+    // req 为空表示请求未解析完成就被拒绝
+    // start 为开始处理请求的时间，耗时按单调时钟计算，不受系统时间调整影响
+    void RecordAccess(const core::ChannelPtr& ctx, const HttpRequest* req,
+                      HttpStatus status, size_t bytes,
+                      std::chrono::steady_clock::time_point start);
+
+    // 在各 EventLoop 中关闭其中的会话，force 为 false 时只关闭空闲会话
+    void CloseSessions(bool force);
+    // 退出完成，只执行一次 on_drained
+    void FinishDrain();
 
 public:
     bool is_keepalive{false};
+    // 每个连接上允许同时处理的流水线请求数
+    size_t max_inflight{16};
+    // 没有在途请求的连接空闲超过该时间（毫秒）后关闭
+    std::time_t idle_timeout{500};
+    // 请求头大小与接收速度限制，应在 StartListen 之前设置
+    HttpRequestLimits request_limits;
     ServletDispatch dispatch;
 
-    std::map<int, std::shared_ptr<HttpSession>> http_sessions_;
+private:
+    // 按 EventLoop 的序号划分，连接只在所属的 EventLoop 中读写自己的会话表，
+    // 事件处理路径上没有跨线程的锁；会话总数只用于判断退出是否完成
+    std::vector<SessionMap> loop_sessions_;
+    std::atomic_size_t session_count_{0};
+
+    std::unique_ptr<core::RateLimiter> request_limiter_;
+    std::unique_ptr<AccessLog> access_log_;
+
+    std::atomic_bool draining_{false};
+    std::atomic_bool drained_{false};
+    std::mutex drain_mtx_;  // 保护 on_drained_ 的设置
+    std::function<void()> on_drained_;
 };
 
 }  // namespace skyline::http
@@ -1,43 +1,129 @@
 #include "http_session.h"
 
-#include <sstream>
+#include <algorithm>
+#include <charconv>
 
 #include "http_parser.h"
 
 namespace skyline::http {
 
-static constexpr size_t kBufSize = 4 * 1024;
+// Content-Length 只能是十进制数字，符号、多余的字符和溢出都视为错误，
+// 否则后续流水线请求的边界无法确定
+static bool ParseContentLength(std::string_view v, size_t& len) {
+    while (!v.empty() && (v.front() == ' ' || v.front() == '\t')) {
+        v.remove_prefix(1);
+    }
+    while (!v.empty() && (v.back() == ' ' || v.back() == '\t')) {
+        v.remove_suffix(1);
+    }
+    if (v.empty()) return false;
+    auto [ptr, ec] = std::from_chars(v.data(), v.data() + v.size(), len);
+    return ec == std::errc{} && ptr == v.data() + v.size();
+}
 
 void HttpSession::Parse(const std::string_view& data) {
-    if (ok_ || error_) return;
-    buffer_ += data;
-    if (!parser_.isFinished()) {
-        auto nparsed = parser_.execute(buffer_.data(), buffer_.size(), 0);
-        buffer_.erase(0, nparsed);
-        if (parser_.hasError()) {
-            error_ = true;
-            return;
+    if (isError() || closed_) return;
+    if (limits_->min_recv_rate > 0) {
+        const auto now = core::ThroughputMeter::NowMsec();
+        // 新请求的第一段数据，开始统计
+        if (!parser_ && buffer_.empty()) {
+            recv_meter_.Reset(now, limits_->recv_rate_window_ms);
         }
-    }
-    if (parser_.isFinished()) {
-        auto v = parser_.data().getHeader("content-length");
-        auto body_len = v == nullptr ? 0 : ::atol(v->c_str());
-        if (buffer_.size() >= body_len) {
-            parser_.data().body.swap(buffer_);
-            ok_ = true;
+        recv_meter_.Add(now, data.size());
+        if (recv_meter_.Below(now, limits_->min_recv_rate)) {
+            error_ = HttpStatus::HTTP_STATUS_REQUEST_TIMEOUT;
+            return;
         }
     }
+    buffer_ += data;
 }
 
 std::unique_ptr<HttpRequest> HttpSession::TryGet() {
-    if (ok_) {
-        // 只允许成功获取一次，之后该会话应该销毁
-        ok_ = false;
-        error_ = true;
-        return std::make_unique<HttpRequest>(std::move(parser_.data()));
-    } else {
+    if (isError() || closed_) return {};
+    if (!parser_) {
+        if (buffer_.empty()) return {};
+        parser_ = std::make_unique<HttpRequestParser>();
+    }
+    if (parser_->isFinished() != 1) {
+        // 请求行解析完之前检查其长度，对方可能一直不发送换行
+        if (parser_->headerBytes() == 0 && limits_->max_request_line > 0 &&
+            std::min(buffer_.find('\n'), buffer_.size()) >
+                limits_->max_request_line) {
+            error_ = HttpStatus::HTTP_STATUS_URI_TOO_LONG;
+            return {};
+        }
+        auto nparsed = parser_->execute(buffer_.data(), buffer_.size(), 0);
+        buffer_.erase(0, nparsed);
+        if (parser_->hasError()) {
+            error_ = HttpStatus::HTTP_STATUS_BAD_REQUEST;
+            return {};
+        }
+        if (auto status = CheckHeaderLimits(); status != HttpStatus{}) {
+            error_ = status;
+            return {};
+        }
+        if (parser_->isFinished() != 1) return {};
+    }
+    size_t body_len = 0;
+    if (auto v = parser_->data().getHeader("content-length");
+        v != nullptr && !ParseContentLength(*v, body_len)) {
+        error_ = HttpStatus::HTTP_STATUS_BAD_REQUEST;
         return {};
     }
+    if (limits_->max_body_bytes > 0 && body_len > limits_->max_body_bytes) {
+        error_ = HttpStatus::HTTP_STATUS_PAYLOAD_TOO_LARGE;
+        return {};
+    }
+    if (buffer_.size() < body_len) return {};
+
+    auto req = std::make_unique<HttpRequest>(std::move(parser_->data()));
+    req->body = buffer_.substr(0, body_len);
+    buffer_.erase(0, body_len);
+    if (buffer_.empty()) {
+        // 没有后续请求的数据，释放解析器和缓冲区
+        parser_.reset();
+        std::string().swap(buffer_);
+    } else {
+        parser_->reset();
+    }
+    return req;
+}
+
+HttpStatus HttpSession::CheckHeaderLimits() const {
+    if (limits_->max_header_count > 0 &&
+        parser_->fieldCount() > limits_->max_header_count) {
+        return HttpStatus::HTTP_STATUS_REQUEST_HEADER_FIELDS_TOO_LARGE;
+    }
+    // 请求头未解析完时，缓冲区中剩余的是不完整的一行，同样计入
+    auto bytes = parser_->headerBytes();
+    if (parser_->isFinished() != 1) bytes += buffer_.size();
+    if (limits_->max_header_bytes > 0 && bytes > limits_->max_header_bytes) {
+        return HttpStatus::HTTP_STATUS_REQUEST_HEADER_FIELDS_TOO_LARGE;
+    }
+    return {};
+}
+
+uint64_t HttpSession::Enqueue() {
+    pending_.emplace_back();
+    return sent_seq_ + pending_.size() - 1;
+}
+
+void HttpSession::Complete(uint64_t seq, std::string data, bool close) {
+    if (seq < sent_seq_ || seq - sent_seq_ >= pending_.size()) return;
+    auto& p = pending_[seq - sent_seq_];
+    p.data = std::move(data);
+    p.close = close;
+}
+
+bool HttpSession::TryPop(std::string& data, bool& close) {
+    if (pending_.empty() || !pending_.front().data) return false;
+    data = std::move(*pending_.front().data);
+    close = pending_.front().close;
+    pending_.erase(pending_.begin());
+    ++sent_seq_;
+    // 所有响应都已发出，归还队列内存
+    if (pending_.empty()) std::vector<PendingResponse>().swap(pending_);
+    return true;
 }
 
 }  // namespace skyline::http
@@ -1,32 +1,94 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
+#include "core/throughput.h"
 #include "core/timer.h"
 #include "http_parser.h"
 
 namespace skyline::http {
 
-// 管理一次 http 请求会话，提供
+// 请求大小与接收速度的限制，用于抵御慢速攻击，为 0 的项不限制
+struct HttpRequestLimits {
+    // 请求行的最大长度，超过时返回 414
+    size_t max_request_line{8192};
+    // 请求头的最大字段数与总字节数（包括请求行），超过时返回 431
+    size_t max_header_count{100};
+    size_t max_header_bytes{16384};
+    // 请求体的最大长度，Content-Length 超过时不接收请求体，直接返回 413
+    size_t max_body_bytes{1 << 20};
+    // 有在途请求时最多缓存的未处理字节数，超过后暂停读取，直到响应发出
+    size_t max_pipeline_bytes{64 * 1024};
+    // 接收一个请求（包括请求体）期间的最低速度，单位字节/秒，
+    // 在 recv_rate_window_ms 的滑动窗口内统计，低于该速度时返回 408
+    size_t min_recv_rate{0};
+    std::time_t recv_rate_window_ms{5000};
+};
+
+// 管理一个连接上的 http 会话，提供
+// 请求的流水线解析、在途请求计数以及响应的按序发送
+// 解析器和缓冲区只在有未处理的数据时存在，空闲会话只占用自身的几十字节
 class HttpSession {
 public:
-    // 根据传入的新数据，继续解析当前请求
+    // limits 由 HttpServer 持有，生命周期长于会话
+    explicit HttpSession(const HttpRequestLimits& limits) noexcept
+        : limits_(&limits) {}
+
+    // 追加新收到的数据，等待 TryGet 解析
     void Parse(const std::string_view& data);
 
-    // 尝试获取解析完毕的请求，未解析完成时返回空指针
+    // 尝试获取下一个解析完毕的请求，未解析完成时返回空指针
+    // 剩余的数据会保留，用于解析同一连接上流水线发送的后续请求
     std::unique_ptr<HttpRequest> TryGet();
 
-    bool isError() { return error_; }
+    bool isError() const noexcept { return error_ != HttpStatus{}; }
+    // 出错时应返回的状态码
+    HttpStatus error() const noexcept { return error_; }
+
+    // 为一个即将处理的请求分配序号，在途请求数加一
+    uint64_t Enqueue();
+
+    // 记录某个序号对应的响应，响应可能乱序完成
+    void Complete(uint64_t seq, std::string data, bool close);
+
+    // 按请求顺序取出下一个已完成的响应，队首未完成时返回 false
+    bool TryPop(std::string& data, bool& close);
+
+    size_t inflight() const noexcept { return pending_.size(); }
+    // 已收到但还未解析成请求的字节数
+    size_t buffered() const noexcept { return buffer_.size(); }
+
+    void close() noexcept { closed_ = true; }
+    bool isClosed() const noexcept { return closed_; }
 
 public:
     // 当前会话对应的定时器 ID
     std::optional<core::Timer::timer_id_t> timer_id;
 
 private:
-    HttpRequestParser parser_;
+    struct PendingResponse {
+        std::optional<std::string> data;
+        bool close{false};
+    };
+
+private:
+    // 超出请求头限制时返回对应的状态码
+    HttpStatus CheckHeaderLimits() const;
+
+private:
+    const HttpRequestLimits* limits_;
+    std::unique_ptr<HttpRequestParser> parser_;
     std::string buffer_;  // 存储未解析完毕的数据
-    bool error_{false};
-    bool ok_{false};
+    HttpStatus error_{};
+    bool closed_{false};
+    // 只在接收请求的过程中统计
+    core::ThroughputMeter recv_meter_;
+
+    // 队首对应序号为 sent_seq_ 的响应，长度不超过 max_inflight
+    // 不使用 std::deque，它在空的时候也会占用数百字节
+    std::vector<PendingResponse> pending_;
+    uint64_t sent_seq_{0};
 };
 
 }  // namespace skyline::http
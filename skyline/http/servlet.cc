@@ -2,22 +2,154 @@
 
 #include <fnmatch.h>
 
+#include <atomic>
+
+#include "core/event_loop.h"
+
 namespace skyline::http {
 
+// ---------------------------- HttpCompletion ----------------------------
+
+struct HttpCompletion::State {
+    core::EventLoop& loop;
+    std::unique_ptr<HttpRequest> request;
+    HttpResponse response;
+    Callback cb;
+    std::atomic_bool completed{false};
+
+    ~State() {
+        if (completed.exchange(true) || !cb) return;
+        response.status = HttpStatus::HTTP_STATUS_INTERNAL_SERVER_ERROR;
+        // std::function 要求可复制，请求转为 shared_ptr
+        loop.RunInLoop([req = std::shared_ptr<HttpRequest>(std::move(request)),
+                        res = std::move(response),
+                        cb = std::move(cb)]() mutable {
+            cb(*req, std::move(res));
+        });
+    }
+};
+
+HttpCompletion::HttpCompletion(core::EventLoop& loop,
+                               std::unique_ptr<HttpRequest> request,
+                               HttpResponse response, Callback cb)
+    : _state(new State{.loop = loop,
+                       .request = std::move(request),
+                       .response = std::move(response),
+                       .cb = std::move(cb)}) {}
+
+const HttpRequest& HttpCompletion::request() const noexcept {
+    return *_state->request;
+}
+
+HttpResponse& HttpCompletion::response() const noexcept {
+    return _state->response;
+}
+
+void HttpCompletion::complete() const {
+    if (_state->completed.exchange(true)) return;
+    _state->loop.RunInLoop([state = _state]() {
+        if (state->cb) state->cb(*state->request, std::move(state->response));
+    });
+}
+
+bool HttpCompletion::isCompleted() const noexcept {
+    return _state->completed;
+}
+
+// ---------------------------- Servlet ----------------------------
+
 Servlet::Servlet(std::string name) : name(std::move(name)) {}
 
+void Servlet::handleAsync(const HttpRequest& request, HttpCompletion completion,
+                          core::ChannelPtr session) {
+    handle(request, completion.response(), session);
+    completion.complete();
+}
+
+int AsyncServlet::handle(const HttpRequest& request, HttpResponse& response,
+                         core::ChannelPtr session) {
+    response.status = HttpStatus::HTTP_STATUS_INTERNAL_SERVER_ERROR;
+    return -1;
+}
+
 FunctionServlet::FunctionServlet(Callback cb)
     : Servlet("FunctionServlet"), _cb(std::move(cb)) {}
 
 int FunctionServlet::handle(const HttpRequest& request, HttpResponse& response,
-                            std::shared_ptr<core::Channel> session) {
+                            core::ChannelPtr session) {
     return _cb(request, response, session);
 }
 
+FunctionAsyncServlet::FunctionAsyncServlet(Callback cb)
+    : AsyncServlet("FunctionAsyncServlet"), _cb(std::move(cb)) {}
+
+void FunctionAsyncServlet::handleAsync(const HttpRequest& request,
+                                       HttpCompletion completion,
+                                       core::ChannelPtr session) {
+    _cb(request, std::move(completion), std::move(session));
+}
+
+void CoroutineServlet::handleAsync(const HttpRequest& request,
+                                   HttpCompletion completion,
+                                   core::ChannelPtr session) {
+    // 挂起期间路由可能被替换或删除，协程帧还引用着 this 和处理函数的闭包
+    // 不由 shared_ptr 管理时 lock() 为空，得到不持有所有权的指针，
+    // 只能由调用方保证存活
+    std::shared_ptr<CoroutineServlet> self(weak_from_this().lock(), this);
+    core::Spawn(
+        run(std::move(self), std::move(completion), std::move(session)));
+}
+
+core::Task<void> CoroutineServlet::run(std::shared_ptr<CoroutineServlet> self,
+                                       HttpCompletion completion,
+                                       core::ChannelPtr session) {
+    co_await self->handleCoroutine(completion.request(), completion.response(),
+                                   std::move(session));
+    completion.complete();
+}
+
+FunctionCoroutineServlet::FunctionCoroutineServlet(Callback cb)
+    : CoroutineServlet("FunctionCoroutineServlet"), _cb(std::move(cb)) {}
+
+core::Task<int> FunctionCoroutineServlet::handleCoroutine(
+    const HttpRequest& request, HttpResponse& response,
+    core::ChannelPtr session) {
+    return _cb(request, response, std::move(session));
+}
+
+OffloadServlet::OffloadServlet(std::unique_ptr<Servlet> servlet,
+                               std::shared_ptr<WorkerPool> pool)
+    : AsyncServlet("OffloadServlet"),
+      _servlet(std::move(servlet)),
+      _pool(std::move(pool)) {}
+
+void OffloadServlet::handleAsync(const HttpRequest& request,
+                                 HttpCompletion completion,
+                                 core::ChannelPtr session) {
+    // 连接的引用计数只能在其 EventLoop 中增减，工作线程中 session 为空
+    auto ok = _pool->TrySubmit([servlet = _servlet, completion]() {
+        servlet->handle(completion.request(), completion.response(), nullptr);
+        completion.complete();
+    });
+    if (ok) return;
+    // 线程池饱和，直接降级
+    static const std::string res_body =
+        "<html><head><title>503 Service Unavailable</title></head><body>"
+        "<center><h1>503 Service Unavailable</h1></center><hr/>"
+        "<center>skyline/1.0.0</center></body></html>";
+    auto& response = completion.response();
+    response.status = HttpStatus::HTTP_STATUS_SERVICE_UNAVAILABLE;
+    response.setHeader("Server", "skyline/1.0.0");
+    response.setHeader("Content-Type", "text/html");
+    response.setHeader("Retry-After", "1");
+    response.body = res_body;
+    completion.complete();
+}
+
 NotFoundServlet::NotFoundServlet() : Servlet("NotFoundServlet") {}
 
 int NotFoundServlet::handle(const HttpRequest& request, HttpResponse& response,
-                            std::shared_ptr<core::Channel> session) {
+                            core::ChannelPtr session) {
     static const std::string res_body =
         "<html><head><title>404 Not Found</title></head><body><center><h1>404 "
         "Not "
@@ -34,28 +166,45 @@ ServletDispatch::ServletDispatch()
       _default(std::make_unique<NotFoundServlet>()) {}
 
 int ServletDispatch::handle(const HttpRequest& request, HttpResponse& response,
-                            std::shared_ptr<core::Channel> session) {
+                            core::ChannelPtr session) {
     return getMatchedServlet(request.path)->handle(request, response, session);
 }
 
+void ServletDispatch::handleAsync(const HttpRequest& request,
+                                  HttpCompletion completion,
+                                  core::ChannelPtr session) {
+    getMatchedServlet(request.path)
+        ->handleAsync(request, std::move(completion), std::move(session));
+}
+
 void ServletDispatch::addServlet(const std::string& uri,
-                                 std::unique_ptr<Servlet> slt) {
+                                 std::unique_ptr<Servlet> slt, bool offload) {
     if (slt) {
+        if (offload) {
+            slt = std::make_unique<OffloadServlet>(std::move(slt),
+                                                   getWorkerPool());
+        }
+        std::shared_ptr<Servlet> servlet(std::move(slt));
         std::lock_guard lock(_mtx);
-        _datas[uri].swap(slt);
+        _datas[uri].swap(servlet);
     }
 }
 
 void ServletDispatch::addServlet(const std::string& uri,
-                                 FunctionServlet::Callback cb) {
+                                 FunctionServlet::Callback cb, bool offload) {
     if (cb) {
-        addServlet(uri, std::make_unique<FunctionServlet>(std::move(cb)));
+        addServlet(uri, std::make_unique<FunctionServlet>(std::move(cb)),
+                   offload);
     }
 }
 
 void ServletDispatch::addGlobServlet(const std::string& uri,
-                                     std::unique_ptr<Servlet> slt) {
+                                     std::unique_ptr<Servlet> slt,
+                                     bool offload) {
     if (!slt) return;
+    if (offload) {
+        slt = std::make_unique<OffloadServlet>(std::move(slt), getWorkerPool());
+    }
     std::lock_guard lock(_mtx);
     auto it = std::find_if(_globs.begin(), _globs.end(),
                            [&](auto& p) { return p.first == uri; });
@@ -64,9 +213,42 @@ void ServletDispatch::addGlobServlet(const std::string& uri,
 }
 
 void ServletDispatch::addGlobServlet(const std::string& uri,
-                                     FunctionServlet::Callback cb) {
+                                     FunctionServlet::Callback cb,
+                                     bool offload) {
+    if (cb) {
+        addGlobServlet(uri, std::make_unique<FunctionServlet>(std::move(cb)),
+                       offload);
+    }
+}
+
+void ServletDispatch::addAsyncServlet(const std::string& uri,
+                                      FunctionAsyncServlet::Callback cb) {
+    if (cb) {
+        addServlet(uri, std::make_unique<FunctionAsyncServlet>(std::move(cb)));
+    }
+}
+
+void ServletDispatch::addAsyncGlobServlet(const std::string& uri,
+                                          FunctionAsyncServlet::Callback cb) {
+    if (cb) {
+        addGlobServlet(uri,
+                       std::make_unique<FunctionAsyncServlet>(std::move(cb)));
+    }
+}
+
+void ServletDispatch::addCoroutineServlet(
+    const std::string& uri, FunctionCoroutineServlet::Callback cb) {
+    if (cb) {
+        addServlet(uri,
+                   std::make_unique<FunctionCoroutineServlet>(std::move(cb)));
+    }
+}
+
+void ServletDispatch::addCoroutineGlobServlet(
+    const std::string& uri, FunctionCoroutineServlet::Callback cb) {
     if (cb) {
-        addGlobServlet(uri, std::make_unique<FunctionServlet>(std::move(cb)));
+        addGlobServlet(
+            uri, std::make_unique<FunctionCoroutineServlet>(std::move(cb)));
     }
 }
 
@@ -84,12 +266,24 @@ void ServletDispatch::delGlobServlet(const std::string& uri) {
 
 void ServletDispatch::setDefault(std::unique_ptr<Servlet> slt) {
     if (slt) {
+        std::shared_ptr<Servlet> servlet(std::move(slt));
         std::lock_guard lock(_mtx);
-        _default.swap(slt);
+        _default.swap(servlet);
     }
 }
 
-std::unique_ptr<Servlet>& ServletDispatch::getMatchedServlet(
+void ServletDispatch::setWorkerPool(std::shared_ptr<WorkerPool> pool) {
+    std::lock_guard lock(_mtx);
+    _pool.swap(pool);
+}
+
+std::shared_ptr<WorkerPool> ServletDispatch::getWorkerPool() {
+    std::lock_guard lock(_mtx);
+    if (!_pool) _pool = std::make_shared<WorkerPool>();
+    return _pool;
+}
+
+std::shared_ptr<Servlet> ServletDispatch::getMatchedServlet(
     const std::string& uri) {
     std::shared_lock lock(_mtx);
     if (auto it = _datas.find(uri); it != _datas.end()) {
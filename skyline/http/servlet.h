@@ -4,52 +4,171 @@
 #include <memory>
 #include <shared_mutex>
 
+#include "core/channel.h"
+#include "core/coroutine.h"
 #include "http.h"
+#include "worker_pool.h"
 
 namespace skyline {
 
 namespace core {
 
-class Channel;
+class EventLoop;
 
-}
+}  // namespace core
 
 namespace http {
 
-class Servlet {
+// 一次请求的完成句柄，持有请求与待填充的响应
+// 可以被复制、在任意线程中调用 complete()，完成回调会通过 RunInLoop
+// 转交回连接所属的 EventLoop 中执行；只有第一次 complete() 生效
+// 若所有副本析构时仍未调用 complete()，将自动以 500 响应完成
+class HttpCompletion {
+public:
+    // request 只在回调期间有效
+    using Callback = std::function<void(const HttpRequest& request,
+                                        HttpResponse&& response)>;
+
+    HttpCompletion(core::EventLoop& loop, std::unique_ptr<HttpRequest> request,
+                   HttpResponse response, Callback cb);
+
+    // complete() 调用前保持有效
+    const HttpRequest& request() const noexcept;
+    HttpResponse& response() const noexcept;
+
+    void complete() const;
+    bool isCompleted() const noexcept;
+
+private:
+    struct State;
+    std::shared_ptr<State> _state;
+};
+
+// 由 shared_ptr 管理时（通过 ServletDispatch 注册的都是），
+// 异步处理可以通过 weak_from_this() 持有自身，路由被替换或删除后仍然有效
+class Servlet : public std::enable_shared_from_this<Servlet> {
 public:
     Servlet(std::string name);
 
     virtual ~Servlet() = default;
 
     virtual int handle(const HttpRequest& request, HttpResponse& response,
-                       std::shared_ptr<core::Channel> session) = 0;
+                       core::ChannelPtr session) = 0;
+
+    // 异步处理入口，默认实现为同步调用 handle 后立即完成
+    // request 由 completion 持有，在 complete() 前一直有效
+    // 注意：session 只能在其所属的 EventLoop 线程中使用
+    virtual void handleAsync(const HttpRequest& request,
+                             HttpCompletion completion,
+                             core::ChannelPtr session);
 
 public:
     const std::string name;
 };
 
+// 异步 servlet，处理函数可以立即返回，稍后（可在其它线程）完成请求
+class AsyncServlet : public Servlet {
+public:
+    using Servlet::Servlet;
+
+    // 异步 servlet 不支持同步调用，填充 500 并返回 -1
+    int handle(const HttpRequest& request, HttpResponse& response,
+               core::ChannelPtr session) override;
+
+    void handleAsync(const HttpRequest& request, HttpCompletion completion,
+                     core::ChannelPtr session) override = 0;
+};
+
 class FunctionServlet : public Servlet {
 public:
     using Callback =
         std::function<int(const HttpRequest& request, HttpResponse& response,
-                          std::shared_ptr<core::Channel> session)>;
+                          core::ChannelPtr session)>;
 
     FunctionServlet(Callback cb);
 
     int handle(const HttpRequest& request, HttpResponse& response,
-               std::shared_ptr<core::Channel> session) override;
+               core::ChannelPtr session) override;
+
+private:
+    Callback _cb;
+};
+
+class FunctionAsyncServlet : public AsyncServlet {
+public:
+    using Callback = std::function<void(const HttpRequest& request,
+                                        HttpCompletion completion,
+                                        core::ChannelPtr session)>;
+
+    FunctionAsyncServlet(Callback cb);
+
+    void handleAsync(const HttpRequest& request, HttpCompletion completion,
+                     core::ChannelPtr session) override;
 
 private:
     Callback _cb;
 };
 
+// 协程 servlet，处理函数可以 co_await 定时器、socket 等而不阻塞 EventLoop
+// 协程在连接所属的 EventLoop 线程中启动，co_return 后自动完成请求
+// 由 shared_ptr 管理时，协程结束前一直持有 servlet 的引用
+class CoroutineServlet : public AsyncServlet {
+public:
+    using AsyncServlet::AsyncServlet;
+
+    // request 与 response 在协程结束前一直有效
+    virtual core::Task<int> handleCoroutine(
+        const HttpRequest& request, HttpResponse& response,
+        core::ChannelPtr session) = 0;
+
+    void handleAsync(const HttpRequest& request, HttpCompletion completion,
+                     core::ChannelPtr session) override;
+
+private:
+    static core::Task<void> run(std::shared_ptr<CoroutineServlet> self,
+                                HttpCompletion completion,
+                                core::ChannelPtr session);
+};
+
+class FunctionCoroutineServlet : public CoroutineServlet {
+public:
+    using Callback = std::function<core::Task<int>(
+        const HttpRequest& request, HttpResponse& response,
+        core::ChannelPtr session)>;
+
+    FunctionCoroutineServlet(Callback cb);
+
+    core::Task<int> handleCoroutine(
+        const HttpRequest& request, HttpResponse& response,
+        core::ChannelPtr session) override;
+
+private:
+    Callback _cb;
+};
+
+// 将同步 servlet 放到工作线程池中执行，结果通过 completion 转交回 EventLoop
+// 线程池饱和时直接返回 503
+// 注意：在工作线程中执行时 session 为空
+// 任务持有被包装 servlet 的引用，路由被替换或删除后，已提交的任务仍可安全执行
+class OffloadServlet : public AsyncServlet {
+public:
+    OffloadServlet(std::unique_ptr<Servlet> servlet,
+                   std::shared_ptr<WorkerPool> pool);
+
+    void handleAsync(const HttpRequest& request, HttpCompletion completion,
+                     core::ChannelPtr session) override;
+
+private:
+    std::shared_ptr<Servlet> _servlet;
+    std::shared_ptr<WorkerPool> _pool;
+};
+
 class NotFoundServlet : public Servlet {
 public:
     NotFoundServlet();
 
     int handle(const HttpRequest& request, HttpResponse& response,
-               std::shared_ptr<core::Channel> session) override;
+               core::ChannelPtr session) override;
 };
 
 class ServletDispatch : public Servlet {
@@ -57,27 +176,49 @@ public:
     ServletDispatch();
 
     int handle(const HttpRequest& request, HttpResponse& response,
-               std::shared_ptr<core::Channel> session) override;
-
-    void addServlet(const std::string& uri, std::unique_ptr<Servlet> slt);
-    void addServlet(const std::string& uri, FunctionServlet::Callback cb);
-    void addGlobServlet(const std::string& uri, std::unique_ptr<Servlet> slt);
-    void addGlobServlet(const std::string& uri, FunctionServlet::Callback cb);
+               core::ChannelPtr session) override;
+    void handleAsync(const HttpRequest& request, HttpCompletion completion,
+                     core::ChannelPtr session) override;
+
+    // offload 为 true 时，servlet 将在工作线程池中执行（只适用于同步 servlet）
+    void addServlet(const std::string& uri, std::unique_ptr<Servlet> slt,
+                    bool offload = false);
+    void addServlet(const std::string& uri, FunctionServlet::Callback cb,
+                    bool offload = false);
+    void addGlobServlet(const std::string& uri, std::unique_ptr<Servlet> slt,
+                        bool offload = false);
+    void addGlobServlet(const std::string& uri, FunctionServlet::Callback cb,
+                        bool offload = false);
+    void addAsyncServlet(const std::string& uri,
+                         FunctionAsyncServlet::Callback cb);
+    void addAsyncGlobServlet(const std::string& uri,
+                             FunctionAsyncServlet::Callback cb);
+    void addCoroutineServlet(const std::string& uri,
+                             FunctionCoroutineServlet::Callback cb);
+    void addCoroutineGlobServlet(const std::string& uri,
+                                 FunctionCoroutineServlet::Callback cb);
 
     void delServlet(const std::string& uri);
     void delGlobServlet(const std::string& uri);
 
     void setDefault(std::unique_ptr<Servlet> slt);
 
-    std::unique_ptr<Servlet>& getMatchedServlet(const std::string& uri);
+    // 设置 offload 路由使用的线程池，请在注册 offload 路由之前调用
+    // 未设置时，第一次注册 offload 路由会创建一个默认线程池
+    void setWorkerPool(std::shared_ptr<WorkerPool> pool);
+    std::shared_ptr<WorkerPool> getWorkerPool();
+
+    // 返回的 servlet 在持有期间不会因路由被替换或删除而析构
+    std::shared_ptr<Servlet> getMatchedServlet(const std::string& uri);
 
 private:
     // uri(/skyline/xxx) -> servlet
-    std::unordered_map<std::string, std::unique_ptr<Servlet>> _datas;
+    std::unordered_map<std::string, std::shared_ptr<Servlet>> _datas;
     // uti(/skyline/*) -> servlet
-    std::vector<std::pair<std::string, std::unique_ptr<Servlet>>> _globs;
+    std::vector<std::pair<std::string, std::shared_ptr<Servlet>>> _globs;
     // default
-    std::unique_ptr<Servlet> _default;
+    std::shared_ptr<Servlet> _default;
+    std::shared_ptr<WorkerPool> _pool;
     std::shared_mutex _mtx;
 };
 
@@ -0,0 +1,58 @@
+#include "worker_pool.h"
+
+namespace skyline::http {
+
+WorkerPool::WorkerPool(unsigned int thread_num, size_t max_queue)
+    : _max_queue(max_queue) {
+    if (thread_num == 0) thread_num = std::thread::hardware_concurrency();
+    if (thread_num == 0) thread_num = 1;
+    for (unsigned int i = 0; i < thread_num; ++i) {
+        _threads.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool() { Stop(); }
+
+bool WorkerPool::TrySubmit(Task task) {
+    {
+        std::lock_guard lock(_mtx);
+        if (_stop || _tasks.size() >= _max_queue) {
+            ++_rejected;
+            return false;
+        }
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+    return true;
+}
+
+void WorkerPool::Stop() {
+    {
+        std::lock_guard lock(_mtx);
+        if (_stop) return;
+        _stop = true;
+    }
+    _cv.notify_all();
+    for (auto& t : _threads) t.join();
+}
+
+size_t WorkerPool::queueSize() {
+    std::lock_guard lock(_mtx);
+    return _tasks.size();
+}
+
+void WorkerPool::WorkerLoop() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock lock(_mtx);
+            _cv.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+            if (_tasks.empty()) return;
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
+
+}  // namespace skyline::http
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace skyline::http {
+
+// 有界工作线程池，用于将耗时的 servlet 移出 I/O 线程执行
+// 等待队列达到上限时拒绝新任务，由调用方决定如何降级
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    // thread_num 为 0 时使用硬件线程数
+    explicit WorkerPool(unsigned int thread_num = 0, size_t max_queue = 1024);
+    WorkerPool(const WorkerPool&) = delete;
+    ~WorkerPool();
+
+    // 提交任务，线程池已满或已停止时返回 false
+    bool TrySubmit(Task task);
+
+    // 停止接收新任务，执行完已排队的任务后退出所有线程
+    void Stop();
+
+    size_t queueSize();
+    size_t maxQueue() const noexcept { return _max_queue; }
+    uint64_t rejected() const noexcept { return _rejected; }
+
+private:
+    void WorkerLoop();
+
+private:
+    const size_t _max_queue;
+    std::vector<std::thread> _threads;
+    std::deque<Task> _tasks;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    bool _stop{false};
+    std::atomic_uint64_t _rejected{0};
+};
+
+}  // namespace skyline::http
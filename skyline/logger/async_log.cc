@@ -1,7 +1,13 @@
 #include "async_log.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <filesystem>
 #include <iomanip>
+#include <tuple>
 
 /**
  * features:
@@ -17,6 +23,7 @@ namespace skyline::logger {
 using namespace std::chrono_literals;
 
 static constexpr size_t kFixedBufferSize = 4000 * 1000;
+static constexpr size_t kMaxSpareBuffers = 2;
 static constexpr auto kFlushInterval = 3s;
 
 class FixedBuffer {
@@ -30,6 +37,13 @@ public:
         return true;
     }
 
+    // 尽可能多地写入，返回写入的字节数
+    size_t writeSome(const std::string_view& data) {
+        auto n = std::min(data.size(), avaliableSpace());
+        write(data.substr(0, n));
+        return n;
+    }
+
     constexpr const char* data() const noexcept { return _buffer.data(); }
     void clear() noexcept { _current = _buffer.begin(); }
 
@@ -41,52 +55,60 @@ private:
     std::array<char, kFixedBufferSize>::iterator _current;
 };
 
-AsyncAppender::AsyncAppender()
-    : _current_buffer(std::make_unique<FixedBuffer>()),
-      _next_buffer(std::make_unique<FixedBuffer>()) {
+AsyncAppender::AsyncAppender() {
     _thread = std::thread([&]() {
-        auto tmp_buffer = std::make_unique<FixedBuffer>();
+        auto current = std::make_unique<FixedBuffer>();
         std::vector<std::unique_ptr<FixedBuffer>> buffers_to_write;
-        buffers_to_write.reserve(2);
-
-        while (!_stop) {
-            // 临界区，负责前后端buffer的交换
-            {
-                std::unique_lock<std::mutex> lock(_mutex);
-                if (_buffers.empty()) {
-                    _cv.wait_for(lock, kFlushInterval);
-                }
-                // 这步操作结束后保证current和next都可用
-                if (_buffers.empty() || _stop) {
-                    // 超时没满，但current有数据，则强制写入，并用备用buffer替换
-                    if (_current_buffer->length() > 0) {
-                        _buffers.push_back(std::move(_current_buffer));
-                        _current_buffer.swap(tmp_buffer);
-                    }
-                } else if (!_next_buffer) {
-                    // 有满buffer情况下，很有可能next为空，则用备用buffer替换
-                    _next_buffer.swap(tmp_buffer);
-                }
-                if (_buffers.empty()) continue;
-                buffers_to_write.swap(_buffers);
+        std::vector<std::unique_ptr<FixedBuffer>> spare_buffers;
+        std::vector<iovec> iov;
+        auto last_write = std::chrono::steady_clock::now();
+
+        auto next_buffer = [&]() {
+            if (spare_buffers.empty()) return std::make_unique<FixedBuffer>();
+            auto b = std::move(spare_buffers.back());
+            spare_buffers.pop_back();
+            return b;
+        };
+        auto consume = [&](std::string_view data) {
+            while (!data.empty()) {
+                data.remove_prefix(current->writeSome(data));
+                if (data.empty()) break;
+                buffers_to_write.push_back(std::move(current));
+                current = next_buffer();
             }
+        };
+
+        auto on_dropped = [&](uint64_t n, uint32_t thread_id) {
+            consume(format("%lu log lines dropped by thread %u\n", n,
+                           thread_id));
+        };
 
-            // 写出buffer
-            for (const auto& b : buffers_to_write) {
-                append(b->data(), b->length());
+        _rings.run(consume, on_dropped, [&](bool stop) {
+            // 有写满的buffer，或者超时、停止时强制写出当前buffer
+            const auto now = std::chrono::steady_clock::now();
+            if (current->length() > 0 &&
+                (stop || now - last_write >= kFlushInterval)) {
+                buffers_to_write.push_back(std::move(current));
+                current = next_buffer();
             }
-            // 清理多余buffer
-            if (buffers_to_write.size() > 1) {
-                buffers_to_write.resize(1);
+            if (!buffers_to_write.empty()) {
+                iov.clear();
+                for (const auto& b : buffers_to_write) {
+                    iov.push_back({const_cast<char*>(b->data()), b->length()});
+                }
+                appendv(iov.data(), iov.size());
+                // 持久化
+                flush();
+                // 回收buffer，多余的释放
+                for (auto& b : buffers_to_write) {
+                    if (spare_buffers.size() >= kMaxSpareBuffers) break;
+                    b->clear();
+                    spare_buffers.push_back(std::move(b));
+                }
+                buffers_to_write.clear();
+                last_write = now;
             }
-            // 恢复备用buffer
-            if (!tmp_buffer) tmp_buffer.swap(buffers_to_write.front());
-            tmp_buffer->clear();
-            buffers_to_write.clear();
-
-            // 持久化
-            flush();
-        }
+        });
     });
 }
 
@@ -96,34 +118,42 @@ AsyncAppender::~AsyncAppender() {
 
 void AsyncAppender::log(const Logger& logger, LogLevel level,
                         const LogEvent& event) {
-    std::stringstream ss;
-    _formatter->format(ss, logger, level, event);
-    std::lock_guard<std::mutex> lock(_mutex);
-    if (!_current_buffer->write(ss.view())) {
-        _buffers.push_back(std::move(_current_buffer));
-        if (_next_buffer) {
-            _current_buffer.swap(_next_buffer);
-        } else {
-            _current_buffer = std::make_unique<FixedBuffer>();
-        }
-        _current_buffer->write(ss.view());
-        _cv.notify_one();
+    static thread_local std::string line;
+    line.clear();
+    _formatter->format(line, logger, level, event);
+    _rings.push(line);
+}
+
+void AsyncAppender::appendv(const iovec* iov, int count) {
+    for (int i = 0; i < count; ++i) {
+        append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
     }
 }
 
 void AsyncAppender::stop() {
-    if (!_stop) {
-        _stop = true;
-        _cv.notify_one();
+    if (_thread.joinable()) {
+        _rings.close();
         _thread.join();
     }
 }
 
+void AsyncAppender::setRingCapacity(size_t capacity) noexcept {
+    _rings.setRingCapacity(capacity);
+}
+
+void AsyncAppender::setFullPolicy(RingFullPolicy policy) noexcept {
+    _rings.setFullPolicy(policy);
+}
+
+uint64_t AsyncAppender::droppedCount() const noexcept {
+    return _rings.droppedCount();
+}
+
 // ---------------------------- AsyncFileAppender ----------------------------
 
 AsyncFileAppender::AsyncFileAppender(const std::string& filename,
-                                     bool thread_safe)
-    : _filestream(filename, std::ios::app), _mutex(nullptr) {
+                                     bool thread_safe, LogFileOptions options)
+    : _file(filename, options), _mutex(nullptr) {
     if (thread_safe) _mutex = new std::mutex;
 }
 
@@ -135,70 +165,225 @@ AsyncFileAppender::~AsyncFileAppender() {
 void AsyncFileAppender::append(const char* data, size_t length) {
     if (_mutex != nullptr) {
         std::lock_guard<std::mutex> lock(*_mutex);
-        _filestream.write(data, length);
+        _file.write(data, length);
+    } else {
+        _file.write(data, length);
+    }
+}
+
+void AsyncFileAppender::appendv(const iovec* iov, int count) {
+    if (_mutex != nullptr) {
+        std::lock_guard<std::mutex> lock(*_mutex);
+        _file.write(iov, count);
     } else {
-        _filestream.write(data, length);
+        _file.write(iov, count);
     }
 }
 
 void AsyncFileAppender::flush() {
     if (_mutex != nullptr) {
         std::lock_guard<std::mutex> lock(*_mutex);
-        _filestream.flush();
+        _file.sync();
     } else {
-        _filestream.flush();
+        _file.sync();
     }
 }
 
 // -------------------------- AsyncRollFileAppender --------------------------
 
-static std::string getLogFilename(std::string basename) {
-    auto t = std::time(NULL);
-    char timebuf[32];
-    std::strftime(timebuf, sizeof timebuf, ".%Y%m%d-%H%M%S",
-                  std::localtime(&t));
-    return basename + timebuf + ".log";
-}
+static constexpr size_t kStampLength = 15;  // %Y%m%d-%H%M%S
 
 AsyncRollFileAppender::AsyncRollFileAppender(std::string basename,
                                              size_t limit_size,
                                              bool thread_safe)
-    : _basename(std::move(basename)), _limit_size(limit_size) {
+    : AsyncRollFileAppender(std::move(basename),
+                            LogRollOptions{.limit_size = limit_size},
+                            thread_safe) {}
+
+AsyncRollFileAppender::AsyncRollFileAppender(std::string basename,
+                                             LogRollOptions options,
+                                             bool thread_safe)
+    : _basename(std::move(basename)), _options(options) {
     if (thread_safe) _mutex = new std::mutex;
-    _filename = getLogFilename(_basename);
-    if (std::filesystem::exists(_filename)) {
-        _file_size = std::filesystem::file_size(_filename);
+    if (_options.compress || _options.max_files > 0) {
+        _archiver = std::make_unique<LogArchiver>(_options.compress,
+                                                  _options.max_files);
+        loadOldFiles();
     }
-    _filestream.open(_filename, std::ios::app);
+    openFile();
 }
 
 AsyncRollFileAppender::~AsyncRollFileAppender() {
     stop();
+    if (_file->size() == 0) ::unlink(_filename.c_str());
     delete _mutex;
 }
 
 void AsyncRollFileAppender::append(const char* data, size_t length) {
-    if (_mutex != nullptr) _mutex->lock();
-    _filestream.write(data, length);
-    _file_size += length;
-    rollFile();
-    if (_mutex != nullptr) _mutex->unlock();
+    iovec iov{const_cast<char*>(data), length};
+    appendv(&iov, 1);
+}
+
+void AsyncRollFileAppender::appendv(const iovec* iov, int count) {
+    if (_mutex != nullptr) {
+        std::lock_guard<std::mutex> lock(*_mutex);
+        writeFile(iov, count);
+    } else {
+        writeFile(iov, count);
+    }
 }
 
 void AsyncRollFileAppender::flush() {
-    if (_mutex != nullptr) _mutex->lock();
-    _filestream.flush();
-    rollFile();
-    if (_mutex != nullptr) _mutex->unlock();
+    if (_mutex != nullptr) {
+        std::lock_guard<std::mutex> lock(*_mutex);
+        _file->sync();
+    } else {
+        _file->sync();
+    }
+}
+
+// 在 iov 中查找第一个或最后一个换行符，返回其后的偏移
+static size_t findNewline(const iovec* iov, int count, bool last) {
+    size_t offset = 0, found = std::string::npos;
+    for (int i = 0; i < count; ++i) {
+        const auto* p = static_cast<const char*>(iov[i].iov_base);
+        const auto* nl = static_cast<const char*>(
+            last ? ::memrchr(p, '\n', iov[i].iov_len)
+                 : std::memchr(p, '\n', iov[i].iov_len));
+        if (nl != nullptr) {
+            found = offset + (nl - p) + 1;
+            if (!last) break;
+        }
+        offset += iov[i].iov_len;
+    }
+    return found;
+}
+
+void AsyncRollFileAppender::writeFile(const iovec* iov, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; ++i) total += iov[i].iov_len;
+    if (total == 0) return;
+
+    // 缓冲区可能在一行的中间截断，只在换行处滚动，保证每行完整地落在一个文件中
+    // 按时间滚动时尽早切分，按大小滚动时整批写入旧文件
+    size_t split = std::string::npos;
+    if (_next_roll != 0 && std::time(nullptr) >= _next_roll) {
+        split = _line_end ? 0 : findNewline(iov, count, false);
+    } else if (_options.limit_size > 0 &&
+               _file->size() + total >= _options.limit_size) {
+        split = findNewline(iov, count, true);
+    }
+    if (split == std::string::npos) {
+        writeRange(iov, count, 0, total);
+    } else {
+        writeRange(iov, count, 0, split);
+        rollFile();
+        writeRange(iov, count, split, total);
+    }
+    for (int i = count - 1; i >= 0; --i) {
+        if (iov[i].iov_len == 0) continue;
+        const auto* p = static_cast<const char*>(iov[i].iov_base);
+        _line_end = p[iov[i].iov_len - 1] == '\n';
+        break;
+    }
+}
+
+void AsyncRollFileAppender::writeRange(const iovec* iov, int count,
+                                       size_t begin, size_t end) {
+    _iov.clear();
+    size_t offset = 0;
+    for (int i = 0; i < count && offset < end; ++i) {
+        const auto len = iov[i].iov_len;
+        if (offset + len > begin) {
+            const auto from = std::max(begin, offset) - offset;
+            const auto to = std::min(end, offset + len) - offset;
+            _iov.push_back(
+                {static_cast<char*>(iov[i].iov_base) + from, to - from});
+        }
+        offset += len;
+    }
+    if (!_iov.empty()) _file->write(_iov.data(), _iov.size());
+}
+
+void AsyncRollFileAppender::openFile() {
+    const auto now = std::time(nullptr);
+    struct tm tm;
+    ::localtime_r(&now, &tm);
+    char stamp[32];
+    std::strftime(stamp, sizeof stamp, "%Y%m%d-%H%M%S", &tm);
+    _seq = _stamp == stamp ? _seq + 1 : 0;
+    _stamp = stamp;
+    // 跳过之前运行留下的文件
+    while (true) {
+        _filename =
+            _basename + "." + _stamp + "." + std::to_string(_seq) + ".log";
+        if (!std::filesystem::exists(_filename) &&
+            !std::filesystem::exists(_filename + ".gz")) {
+            break;
+        }
+        ++_seq;
+    }
+    _file = std::make_unique<LogFile>(_filename, _options.file);
+
+    if (_options.interval.count() > 0) {
+        // 按本地时间对齐，例如按天滚动时在本地零点滚动
+        const auto interval = _options.interval.count();
+        const auto local = now + tm.tm_gmtoff;
+        _next_roll = (local / interval + 1) * interval - tm.tm_gmtoff;
+    }
 }
 
 void AsyncRollFileAppender::rollFile() {
-    if (_file_size >= _limit_size) {
-        _filename = getLogFilename(_basename);
-        _filestream.close();
-        _filestream.open(_filename, std::ios::app);
-        _file_size = 0;
+    const bool empty = _file->size() == 0;
+    auto filename = std::move(_filename);
+    _file.reset();
+    openFile();
+    // 按时间滚动时可能遇到一直没有写入的文件
+    if (empty) {
+        ::unlink(filename.c_str());
+    } else if (_archiver) {
+        _archiver->add(std::move(filename));
+    }
+}
+
+void AsyncRollFileAppender::loadOldFiles() {
+    namespace fs = std::filesystem;
+    const fs::path base(_basename);
+    const auto dir = base.parent_path();
+    const auto prefix = base.filename().string() + ".";
+
+    // 按 (时间, 序号) 排序，序号不补零，不能直接按文件名排序
+    std::vector<std::tuple<std::string, unsigned, std::string>> files;
+    std::error_code ec;
+    for (const auto& entry :
+         fs::directory_iterator(dir.empty() ? fs::path(".") : dir, ec)) {
+        const auto name = entry.path().filename().string();
+        std::string_view rest(name);
+        if (!rest.starts_with(prefix)) continue;
+        rest.remove_prefix(prefix.size());
+        const bool gz = rest.ends_with(".gz");
+        if (gz) rest.remove_suffix(3);
+        if (!rest.ends_with(".log")) continue;
+        rest.remove_suffix(4);
+        if (rest.size() <= kStampLength + 1 || rest[8] != '-' ||
+            rest[kStampLength] != '.') {
+            continue;
+        }
+        unsigned seq = 0;
+        const auto seq_str = rest.substr(kStampLength + 1);
+        auto [end, err] = std::from_chars(
+            seq_str.data(), seq_str.data() + seq_str.size(), seq);
+        if (err != std::errc() || end != seq_str.data() + seq_str.size()) {
+            continue;
+        }
+        auto path = (dir / name).string();
+        // 原文件还在说明上次压缩没有完成，以原文件为准重新压缩
+        if (gz && fs::exists(path.substr(0, path.size() - 3), ec)) continue;
+        files.emplace_back(std::string(rest.substr(0, kStampLength)), seq,
+                           std::move(path));
     }
+    std::sort(files.begin(), files.end());
+    for (auto& file : files) _archiver->add(std::move(std::get<2>(file)));
 }
 
 }  // namespace skyline::logger
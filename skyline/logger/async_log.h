@@ -1,16 +1,19 @@
 #pragma once
 
-#include <condition_variable>
+#include <chrono>
 #include <thread>
 
 #include "log.h"
+#include "log_file.h"
+#include "log_ring.h"
 
 namespace skyline::logger {
 
-class FixedBuffer;
-
 // 异步输出地：纯虚类，子类需要实现将日志添加以及持久化的函数
-// 它将在缓冲区满或者满足超时条件时调用子类的方法持久化日志
+// 每个写日志的线程第一次写入时注册一个单生产者单消费者的环形缓冲区，
+// 之后只写入自己的缓冲区，不加锁；后台线程定期取走所有缓冲区中的数据，
+// 在缓冲区满或者满足超时条件时调用子类的方法持久化日志
+// 同一线程的日志保持顺序，不同线程之间的日志不保证按时间排序
 // 除纯虚函数外，该基类内部操作保证线程安全
 class AsyncAppender : virtual public LogAppender {
 public:
@@ -23,55 +26,84 @@ public:
     // 子类析构时必须调用此函数，避免线程内部访问子类方法错误
     void stop();
 
+    // 每个线程的缓冲区大小，向上取整为 2 的幂，只影响之后注册的线程
+    void setRingCapacity(size_t capacity) noexcept;
+    void setFullPolicy(RingFullPolicy policy) noexcept;
+    // DROP_COUNTED 策略下累计丢弃的日志条数
+    uint64_t droppedCount() const noexcept;
+
 private:
     virtual void append(const char* data, size_t length) = 0;
+    // 一次写出多个缓冲区，默认依次调用 append
+    virtual void appendv(const iovec* iov, int count);
     virtual void flush() = 0;
 
 private:
-    std::unique_ptr<FixedBuffer> _current_buffer;
-    std::unique_ptr<FixedBuffer> _next_buffer;
-    std::vector<std::unique_ptr<FixedBuffer>> _buffers;
+    LogRingSet _rings;
     std::thread _thread;
-    std::mutex _mutex;
-    std::condition_variable _cv;
-    std::atomic_bool _stop{false};
 };
 
+// 一次 writev 写出所有待写的缓冲区，flush 时按 options 持久化
 class AsyncFileAppender : virtual public AsyncAppender {
 public:
-    AsyncFileAppender(const std::string& filename, bool thread_safe);
+    AsyncFileAppender(const std::string& filename, bool thread_safe,
+                      LogFileOptions options = {});
     ~AsyncFileAppender();
 
     void append(const char* data, size_t length) override;
+    void appendv(const iovec* iov, int count) override;
     void flush() override;
 
 protected:
-    std::ofstream _filestream;
+    LogFile _file;
     std::mutex* _mutex{nullptr};
 };
 
+struct LogRollOptions {
+    size_t limit_size{0};  // 按大小滚动，0 表示不按大小滚动
+    // 按时间滚动，按本地时间对齐（如按天滚动时在零点滚动），0 表示不按时间滚动
+    std::chrono::seconds interval{0};
+    size_t max_files{0};   // 保留的已滚动文件数，0 表示不限
+    bool compress{false};  // 后台 gzip 压缩已滚动的文件
+    LogFileOptions file;
+};
+
 /// @brief
-/// 异步滚动日志，limit_size应大于4M（缓冲区影响）
-/// 其次如果日志滚动速度过小于到1s则失效（文件名影响）
+/// 异步滚动日志，文件名为 basename.日期-时间.序号.log，同一秒内多次滚动时序号递增
+/// 只在换行处滚动：按大小滚动时整批写入旧文件，文件可能超出 limit_size
+/// 最多一批（约4M）的数据；按时间滚动时在时间到达后的第一个换行处滚动
+/// 启动时会接管同名的旧文件，参与数量限制，未压缩的会被压缩
 class AsyncRollFileAppender : virtual public AsyncAppender {
 public:
     AsyncRollFileAppender(std::string basename, size_t limit_size,
                           bool thread_safe);
+    AsyncRollFileAppender(std::string basename, LogRollOptions options,
+                          bool thread_safe);
     ~AsyncRollFileAppender();
 
     void append(const char* data, size_t length) override;
+    void appendv(const iovec* iov, int count) override;
     void flush() override;
 
 private:
+    void openFile();
     void rollFile();
+    void writeFile(const iovec* iov, int count);
+    void writeRange(const iovec* iov, int count, size_t begin, size_t end);
+    void loadOldFiles();
 
 private:
     std::string _basename;
+    LogRollOptions _options;
+    std::unique_ptr<LogFile> _file;
     std::string _filename;
-    std::ofstream _filestream;
-    size_t _file_size{0};
+    std::string _stamp;    // 当前文件名中的时间
+    unsigned _seq{0};      // 当前文件名中的序号
+    time_t _next_roll{0};  // 下一次按时间滚动的时刻
+    bool _line_end{true};  // 已写入的数据是否以换行结尾
+    std::vector<iovec> _iov;
+    std::unique_ptr<LogArchiver> _archiver;
     std::mutex* _mutex{nullptr};
-    size_t _limit_size{0};
 };
 
 }  // namespace skyline::logger
@@ -0,0 +1,383 @@
+#include "binary_log.h"
+
+#include <cctype>
+#include <cinttypes>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * features:
+ * C++11:
+ *  thread_local, unordered_map, mutex
+ * C++17:
+ *  string_view, if constexpr, fold expression
+ * C++20:
+ *  __VA_OPT__, source_location, [[unlikely]]
+ **/
+
+namespace skyline::logger {
+
+static constexpr char kFileMagic[8] = {'S', 'K', 'Y', 'B', 'L', 'O', 'G', '1'};
+static constexpr size_t kHeaderSize = detail::RecordWriter::kHeaderSize;
+
+// ---------------------------- 调用处注册 ----------------------------
+
+static std::mutex kSiteMutex;
+static std::vector<LogSite*> kSites;  // 下标为 id - 1
+
+uint32_t BinaryLogger::registerSite(LogSite& site, const char* types) {
+    std::lock_guard<std::mutex> lock(kSiteMutex);
+    if (auto id = site.id.load(std::memory_order_relaxed)) return id;
+    site.types = types;
+    kSites.push_back(&site);
+    const auto id = static_cast<uint32_t>(kSites.size());
+    site.id.store(id, std::memory_order_release);
+    return id;
+}
+
+static const LogSite* findSite(uint32_t id) {
+    std::lock_guard<std::mutex> lock(kSiteMutex);
+    return id > 0 && id <= kSites.size() ? kSites[id - 1] : nullptr;
+}
+
+char* BinaryLogger::recordBuffer() noexcept {
+    static thread_local char buffer[kMaxRecordSize];
+    return buffer;
+}
+
+// ---------------------------- 参数解码 ----------------------------
+
+class ArgReader {
+public:
+    explicit ArgReader(std::string_view args) : _args(args) {}
+
+    template <typename T>
+    T get() noexcept {
+        T v{};
+        if (_args.size() >= sizeof(T)) {
+            std::memcpy(&v, _args.data(), sizeof(T));
+            _args.remove_prefix(sizeof(T));
+        }
+        return v;
+    }
+
+    std::string_view getString() noexcept {
+        const auto len = std::min<size_t>(get<uint32_t>(), _args.size());
+        auto s = _args.substr(0, len);
+        _args.remove_prefix(len);
+        return s;
+    }
+
+private:
+    std::string_view _args;
+};
+
+template <typename T>
+static void appendFormat(std::string& out, const std::string& spec, T v) {
+    char buf[128];
+    int n = std::snprintf(buf, sizeof buf, spec.c_str(), v);
+    if (n < 0) return;
+    if (static_cast<size_t>(n) < sizeof buf) {
+        out.append(buf, n);
+        return;
+    }
+    const auto old = out.size();
+    out.resize(old + n + 1);
+    std::snprintf(out.data() + old, n + 1, spec.c_str(), v);
+    out.resize(old + n);
+}
+
+// spec 为去掉长度修饰和转换符的部分，例如 `%-8.3`
+static void appendArg(std::string& out, std::string spec, char conv, char type,
+                      ArgReader& reader) {
+    auto is = [conv](const char* convs) {
+        return std::strchr(convs, conv) != nullptr;
+    };
+    switch (type) {
+        case 'i': {
+            auto v = reader.get<int64_t>();
+            if (conv == 'c') {
+                appendFormat(out, spec + 'c', static_cast<int>(v));
+            } else {
+                appendFormat(out, spec + "ll" + (is("diouxX") ? conv : 'd'),
+                             static_cast<long long>(v));
+            }
+            break;
+        }
+        case 'u': {
+            auto v = reader.get<uint64_t>();
+            if (conv == 'c') {
+                appendFormat(out, spec + 'c', static_cast<int>(v));
+            } else {
+                appendFormat(out, spec + "ll" + (is("diouxX") ? conv : 'u'),
+                             static_cast<unsigned long long>(v));
+            }
+            break;
+        }
+        case 'f':
+            appendFormat(out, spec + (is("fFeEgGaA") ? conv : 'g'),
+                         reader.get<double>());
+            break;
+        case 's': {
+            // 字符串不以 0 结尾，用精度限制长度
+            auto s = reader.getString();
+            auto dot = spec.find('.');
+            auto len = s.size();
+            if (dot != spec.npos) {
+                len = std::min<size_t>(len, std::atoi(spec.c_str() + dot + 1));
+                spec.resize(dot);
+            }
+            spec += ".*s";
+            char buf[128];
+            int n = std::snprintf(buf, sizeof buf, spec.c_str(),
+                                  static_cast<int>(len), s.data());
+            if (n >= 0 && static_cast<size_t>(n) < sizeof buf) {
+                out.append(buf, n);
+            } else if (n >= 0) {
+                const auto old = out.size();
+                out.resize(old + n + 1);
+                std::snprintf(out.data() + old, n + 1, spec.c_str(),
+                              static_cast<int>(len), s.data());
+                out.resize(old + n);
+            }
+            break;
+        }
+        case 'p':
+            appendFormat(out, spec + 'p',
+                         reinterpret_cast<void*>(reader.get<uintptr_t>()));
+            break;
+        default:  // 参数不足，原样输出
+            out += spec;
+            out += conv;
+    }
+}
+
+static std::string formatArgs(std::string_view fmt, const char* types,
+                              std::string_view args) {
+    std::string out;
+    ArgReader reader(args);
+    for (size_t i = 0; i < fmt.size();) {
+        auto pct = fmt.find('%', i);
+        out.append(fmt.substr(i, pct - i));
+        if (pct == fmt.npos) break;
+        if (pct + 1 < fmt.size() && fmt[pct + 1] == '%') {
+            out += '%';
+            i = pct + 2;
+            continue;
+        }
+        auto j = pct + 1;
+        auto skip = [&](auto pred) {
+            while (j < fmt.size() && pred(fmt[j])) ++j;
+        };
+        auto is_digit = [](char c) { return std::isdigit(c) != 0; };
+        skip([](char c) { return std::strchr("-+ #0", c) != nullptr; });
+        skip(is_digit);
+        if (j < fmt.size() && fmt[j] == '.') {
+            ++j;
+            skip(is_digit);
+        }
+        std::string spec(fmt.substr(pct, j - pct));
+        skip([](char c) { return std::strchr("hljztLq", c) != nullptr; });
+        if (j >= fmt.size()) {
+            out.append(fmt.substr(pct));
+            break;
+        }
+        appendArg(out, std::move(spec), fmt[j], *types ? *types++ : '\0',
+                  reader);
+        i = j + 1;
+    }
+    return out;
+}
+
+// 填充 event 中记录相关的字段
+static void decodeRecord(LogEvent& event, std::string_view record,
+                         const char* fmt, const char* types) {
+    int64_t time;
+    std::memcpy(&time, record.data() + 8, 8);
+    std::memcpy(&event.thread_id, record.data() + 16, 4);
+    event.time = time / 1000000000;
+    event.content = formatArgs(fmt, types, record.substr(kHeaderSize));
+}
+
+// ---------------------------- BinaryLogger ----------------------------
+
+BinaryLogger::BinaryLogger(Logger& logger)
+    : _logger(&logger), _thread([this]() { run(); }) {}
+
+BinaryLogger::BinaryLogger(std::string name, const std::string& filename)
+    : _name(std::move(name)),
+      _file(filename, std::ios::binary | std::ios::trunc) {
+    if (!_file) {
+        auto& logger = getRootLogger();
+        LOG_FMT_ERROR(logger, "binary log file: `%s` open failed",
+                      filename.c_str());
+    }
+    const auto len = static_cast<uint32_t>(_name.size());
+    _file.write(kFileMagic, sizeof kFileMagic);
+    _file.write(reinterpret_cast<const char*>(&len), 4);
+    _file.write(_name.data(), len);
+    _thread = std::thread([this]() { run(); });
+}
+
+BinaryLogger::~BinaryLogger() { stop(); }
+
+void BinaryLogger::stop() {
+    if (_thread.joinable()) {
+        _rings.close();
+        _thread.join();
+    }
+}
+
+void BinaryLogger::setRingCapacity(size_t capacity) noexcept {
+    _rings.setRingCapacity(capacity);
+}
+
+void BinaryLogger::setFullPolicy(RingFullPolicy policy) noexcept {
+    _rings.setFullPolicy(policy);
+}
+
+uint64_t BinaryLogger::droppedCount() const noexcept {
+    return _rings.droppedCount();
+}
+
+void BinaryLogger::run() {
+    static LogSite dropped_site(LogLevel::WARN,
+                                "%lu binary log records dropped by thread %u");
+    auto on_dropped = [&](uint64_t n, uint32_t thread_id) {
+        char buf[64];
+        detail::RecordWriter writer(
+            buf, sizeof buf,
+            registerSite(dropped_site, detail::kArgTypes<uint64_t, uint32_t>),
+            thread_id, detail::nowNsec());
+        writer.put(n);
+        writer.put(thread_id);
+        _pending.append(writer.finish());
+    };
+
+    _rings.run([&](std::string_view data) { _pending.append(data); },
+               on_dropped, [&](bool) {
+                   if (_pending.empty()) return;
+                   process(_pending);
+                   _pending.clear();
+                   if (_file.is_open()) _file.flush();
+               });
+}
+
+void BinaryLogger::process(std::string_view records) {
+    while (records.size() >= kHeaderSize) {
+        uint32_t id, size;
+        std::memcpy(&id, records.data(), 4);
+        std::memcpy(&size, records.data() + 4, 4);
+        if (size < kHeaderSize || size > records.size()) break;
+        auto record = records.substr(0, size);
+        records.remove_prefix(size);
+
+        if (id > _sites.size() || _sites[id - 1] == nullptr) {
+            _sites.resize(std::max<size_t>(_sites.size(), id));
+            _sites[id - 1] = findSite(id);
+            if (_sites[id - 1] == nullptr) continue;
+        }
+        const auto& site = *_sites[id - 1];
+
+        if (_logger != nullptr) {
+            LogEvent event;
+            event.file = site.file;
+            event.line = site.line;
+            decodeRecord(event, record, site.fmt, site.types);
+            _logger->log(site.level, event);
+            continue;
+        }
+
+        // 调用处第一次出现在文件中时，先写入它的定义，id 为 0 表示定义
+        if (id > _written_sites.size()) _written_sites.resize(id);
+        if (!_written_sites[id - 1]) {
+            _written_sites[id - 1] = true;
+            std::string def(20, '\0');
+            const uint32_t zero = 0, line = site.line,
+                           level = static_cast<uint32_t>(site.level);
+            def.append(site.file).push_back('\0');
+            def.append(site.fmt).push_back('\0');
+            def.append(site.types).push_back('\0');
+            const auto def_size = static_cast<uint32_t>(def.size());
+            std::memcpy(def.data(), &zero, 4);
+            std::memcpy(def.data() + 4, &def_size, 4);
+            std::memcpy(def.data() + 8, &id, 4);
+            std::memcpy(def.data() + 12, &line, 4);
+            std::memcpy(def.data() + 16, &level, 4);
+            _file.write(def.data(), def.size());
+        }
+        _file.write(record.data(), record.size());
+    }
+}
+
+// ---------------------------- 离线解码 ----------------------------
+
+bool decodeBinaryLog(std::istream& in, std::ostream& out,
+                     const LogFormatter& formatter) {
+    char magic[sizeof kFileMagic];
+    uint32_t name_len = 0;
+    if (!in.read(magic, sizeof magic) ||
+        std::memcmp(magic, kFileMagic, sizeof magic) != 0 ||
+        !in.read(reinterpret_cast<char*>(&name_len), 4)) {
+        return false;
+    }
+    std::string name(name_len, '\0');
+    if (!in.read(name.data(), name_len)) return false;
+    Logger logger(name);
+
+    struct SiteDef {
+        LogLevel level;
+        uint32_t line;
+        std::string file;
+        std::string fmt;
+        std::string types;
+    };
+    std::unordered_map<uint32_t, SiteDef> sites;
+    std::string entry;
+    while (true) {
+        char head[8];
+        in.read(head, sizeof head);
+        if (in.gcount() == 0 && in.eof()) return true;
+        if (in.gcount() != sizeof head) return false;
+        uint32_t id, size;
+        std::memcpy(&id, head, 4);
+        std::memcpy(&size, head + 4, 4);
+        if (size < kHeaderSize) return false;
+        entry.resize(size);
+        std::memcpy(entry.data(), head, sizeof head);
+        if (!in.read(entry.data() + sizeof head, size - sizeof head)) {
+            return false;
+        }
+
+        if (id == 0) {  // 调用处定义
+            uint32_t site_id, line, level;
+            std::memcpy(&site_id, entry.data() + 8, 4);
+            std::memcpy(&line, entry.data() + 12, 4);
+            std::memcpy(&level, entry.data() + 16, 4);
+            // 三个以 0 结尾的字符串
+            std::string_view rest(entry.data() + 20, size - 20);
+            std::string_view strs[3];
+            for (auto& s : strs) {
+                auto end = rest.find('\0');
+                if (end == rest.npos) return false;
+                s = rest.substr(0, end);
+                rest.remove_prefix(end + 1);
+            }
+            sites[site_id] = SiteDef{static_cast<LogLevel>(level), line,
+                                     std::string(strs[0]), std::string(strs[1]),
+                                     std::string(strs[2])};
+            continue;
+        }
+
+        auto it = sites.find(id);
+        if (it == sites.end()) return false;
+        const auto& site = it->second;
+        LogEvent event;
+        event.file = site.file.c_str();
+        event.line = site.line;
+        decodeRecord(event, entry, site.fmt.c_str(), site.types.c_str());
+        formatter.format(out, logger, site.level, event);
+    }
+}
+
+}  // namespace skyline::logger
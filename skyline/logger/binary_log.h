@@ -0,0 +1,222 @@
+/**
+ * 二进制日志（延迟格式化）：
+ *      调用处只记录格式串的编号和参数的原始字节，写入当前线程的环形缓冲区，
+ *      格式化推迟到后台线程或者离线解码工具中进行，适合反应堆线程等对延迟敏感的地方
+ *
+ * 两种输出方式：
+ *      BinaryLogger(logger)         后台线程格式化后交给 logger 的输出地
+ *      BinaryLogger(name, filename) 后台线程直接写出二进制文件，用 log_decoder 解码
+ *
+ * 格式串使用 printf 风格，参数支持整数、枚举、浮点数、字符串和指针
+ * 长度修饰符（l、ll、z 等）被忽略，按参数的实际类型输出；不支持 `*` 宽度
+ * 单条记录最多 kMaxRecordSize 字节，超出部分的字符串会被截断
+ *
+ * example:
+ *      skyline::logger::BinaryLogger blog(skyline::logger::getRootLogger());
+ *      SKYLINE_BLOG_INFO(blog, "%s %d", "GET", 200);
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+#include "log.h"
+#include "log_ring.h"
+
+#define SKYLINE_BLOG(blog, lv, fmt, ...)                                 \
+    do {                                                                 \
+        if ((blog).level <= lv) {                                        \
+            static skyline::logger::LogSite _skyline_log_site(lv, fmt);  \
+            (blog).log(_skyline_log_site __VA_OPT__(, ) __VA_ARGS__);    \
+        }                                                                \
+    } while (0)
+
+#define SKYLINE_BLOG_DEBUG(blog, fmt, ...) \
+    SKYLINE_BLOG(blog, skyline::logger::LogLevel::DEBUG, fmt, __VA_ARGS__)
+#define SKYLINE_BLOG_INFO(blog, fmt, ...) \
+    SKYLINE_BLOG(blog, skyline::logger::LogLevel::INFO, fmt, __VA_ARGS__)
+#define SKYLINE_BLOG_WARN(blog, fmt, ...) \
+    SKYLINE_BLOG(blog, skyline::logger::LogLevel::WARN, fmt, __VA_ARGS__)
+#define SKYLINE_BLOG_ERROR(blog, fmt, ...) \
+    SKYLINE_BLOG(blog, skyline::logger::LogLevel::ERROR, fmt, __VA_ARGS__)
+#define SKYLINE_BLOG_FATAL(blog, fmt, ...) \
+    SKYLINE_BLOG(blog, skyline::logger::LogLevel::FATAL, fmt, __VA_ARGS__)
+
+namespace skyline::logger {
+
+// 日志调用处的静态信息，每个调用处一个，第一次写日志时注册得到编号
+struct LogSite {
+    LogSite(LogLevel level, const char* fmt,
+            std::source_location loc = std::source_location::current()) noexcept
+        : level(level), fmt(fmt), file(loc.file_name()), line(loc.line()) {}
+
+    const LogLevel level;
+    const char* const fmt;
+    const char* const file;
+    const uint32_t line;
+    const char* types{nullptr};  // 参数类型，注册时写入
+    std::atomic_uint32_t id{0};  // 0 表示尚未注册
+};
+
+namespace detail {
+
+// 参数类型编码：i 有符号整数，u 无符号整数，f 浮点数，s 字符串，p 指针
+template <typename T>
+constexpr char argType() {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_enum_v<U>) {
+        return argType<std::underlying_type_t<U>>();
+    } else if constexpr (std::is_integral_v<U>) {
+        return std::is_signed_v<U> ? 'i' : 'u';
+    } else if constexpr (std::is_floating_point_v<U>) {
+        return 'f';
+    } else if constexpr (std::is_convertible_v<const U&, std::string_view>) {
+        return 's';
+    } else if constexpr (std::is_pointer_v<U>) {
+        return 'p';
+    } else {
+        static_assert(sizeof(U) == 0, "unsupported binary log argument type");
+    }
+}
+
+template <typename... Args>
+inline constexpr char kArgTypes[] = {argType<Args>()..., '\0'};
+
+// 记录中的时间戳，不依赖 system_clock 的计时单位
+inline int64_t nowNsec() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// 记录格式：site id(4) | 记录长度(4) | 纳秒时间戳(8) | 线程 id(4) | 参数
+// 数值参数固定 8 字节，字符串为 长度(4) | 内容
+class RecordWriter {
+public:
+    static constexpr size_t kHeaderSize = 20;
+
+    RecordWriter(char* buf, size_t size, uint32_t id, uint32_t thread_id,
+                 int64_t time) noexcept
+        : _begin(buf), _cur(buf + kHeaderSize), _end(buf + size) {
+        std::memcpy(_begin, &id, 4);
+        std::memcpy(_begin + 8, &time, 8);
+        std::memcpy(_begin + 16, &thread_id, 4);
+    }
+
+    template <typename T>
+    void put(const T& v) noexcept {
+        constexpr char type = argType<T>();
+        if constexpr (type == 'i') {
+            putRaw(static_cast<int64_t>(v));
+        } else if constexpr (type == 'u') {
+            putRaw(static_cast<uint64_t>(v));
+        } else if constexpr (type == 'f') {
+            putRaw(static_cast<double>(v));
+        } else if constexpr (type == 's') {
+            // 与 printf 一致，空指针记录为 (null)
+            if constexpr (std::is_pointer_v<std::decay_t<T>>) {
+                putString(v != nullptr ? std::string_view(v) : "(null)");
+            } else {
+                putString(std::string_view(v));
+            }
+        } else {
+            putRaw(reinterpret_cast<uintptr_t>(v));
+        }
+    }
+
+    // 写入记录长度，返回完整的记录
+    std::string_view finish() noexcept {
+        const auto size = static_cast<uint32_t>(_cur - _begin);
+        std::memcpy(_begin + 4, &size, 4);
+        return {_begin, size};
+    }
+
+private:
+    template <typename T>
+    void putRaw(T v) noexcept {
+        static_assert(sizeof(T) == 8);
+        if (_end - _cur < 8) return;
+        std::memcpy(_cur, &v, 8);
+        _cur += 8;
+    }
+
+    void putString(std::string_view s) noexcept {
+        if (_end - _cur < 4) return;
+        const auto len = static_cast<uint32_t>(
+            std::min<size_t>(s.size(), _end - _cur - 4));
+        std::memcpy(_cur, &len, 4);
+        std::memcpy(_cur + 4, s.data(), len);
+        _cur += 4 + len;
+    }
+
+private:
+    char* _begin;
+    char* _cur;
+    char* _end;
+};
+
+}  // namespace detail
+
+class BinaryLogger {
+public:
+    static constexpr size_t kMaxRecordSize = 4096;
+
+    // 后台线程格式化后交给 logger，logger 的输出地会在后台线程中被调用
+    explicit BinaryLogger(Logger& logger);
+    // 后台线程写出二进制文件，name 作为解码时的日志器名称
+    BinaryLogger(std::string name, const std::string& filename);
+    BinaryLogger(const BinaryLogger&) = delete;
+    ~BinaryLogger();
+
+    template <typename... Args>
+    void log(LogSite& site, const Args&... args) {
+        auto id = site.id.load(std::memory_order_acquire);
+        if (id == 0) [[unlikely]] {
+            id = registerSite(site, detail::kArgTypes<Args...>);
+        }
+        detail::RecordWriter writer(recordBuffer(), kMaxRecordSize, id,
+                                    getThreadID(), detail::nowNsec());
+        (writer.put(args), ...);
+        _rings.push(writer.finish());
+    }
+
+    // 写出剩余的记录并停止后台线程
+    void stop();
+
+    void setRingCapacity(size_t capacity) noexcept;
+    void setFullPolicy(RingFullPolicy policy) noexcept;
+    uint64_t droppedCount() const noexcept;
+
+public:
+    AtomicLogLevel level{LogLevel::DEBUG};
+
+private:
+    static uint32_t registerSite(LogSite& site, const char* types);
+    static char* recordBuffer() noexcept;
+
+    void run();
+    void process(std::string_view records);
+
+private:
+    Logger* _logger{nullptr};
+    std::string _name;
+    std::ofstream _file;
+    std::vector<bool> _written_sites;  // 已写入文件的调用处
+    std::vector<const LogSite*> _sites;  // 后台线程缓存的调用处
+    std::string _pending;
+    LogRingSet _rings;
+    std::thread _thread;
+};
+
+// 解码 BinaryLogger 写出的二进制文件，按 formatter 的格式输出
+// 文件格式错误或者被截断时返回 false，之前的记录仍会输出
+bool decodeBinaryLog(std::istream& in, std::ostream& out,
+                     const LogFormatter& formatter);
+
+}  // namespace skyline::logger
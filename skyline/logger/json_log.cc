@@ -0,0 +1,163 @@
+#include "json_log.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace skyline::logger {
+
+namespace {
+
+bool needEscape(unsigned char c) noexcept {
+    return c < 0x20 || c == 0x7f || c == '"' || c == '\\';
+}
+
+// 以下两个函数内联到各个版本中，由调用者的指令集编码：AVX2 版本跳转到
+// 非 VEX 编码的 SSE 指令而没有 vzeroupper 时，每次调用会有数百纳秒的状态切换
+[[gnu::always_inline]] inline size_t findEscapeScalar(const char* data,
+                                                     size_t pos,
+                                                     size_t size) noexcept {
+    for (; pos < size; ++pos) {
+        if (needEscape(static_cast<unsigned char>(data[pos]))) return pos;
+    }
+    return size;
+}
+
+#if defined(__x86_64__)
+
+// x86-64 总是支持 SSE2；min(c, 0x1f) == c 即无符号的 c < 0x20
+[[gnu::always_inline]] inline size_t findEscapeSse2(const char* data,
+                                                   size_t pos,
+                                                   size_t size) noexcept {
+    const auto ctrl = _mm_set1_epi8(0x1f);
+    const auto del = _mm_set1_epi8(0x7f);
+    const auto quote = _mm_set1_epi8('"');
+    const auto backslash = _mm_set1_epi8('\\');
+    for (; pos + 16 <= size; pos += 16) {
+        const auto v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const auto m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v),
+                         _mm_cmpeq_epi8(v, del)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                         _mm_cmpeq_epi8(v, backslash)));
+        if (const int mask = _mm_movemask_epi8(m); mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    return findEscapeScalar(data, pos, size);
+}
+
+// 按运行的 CPU 选择实现，由动态链接器在加载时解析，调用处没有额外的判断
+__attribute__((target("default"))) size_t findEscapeSimd(
+    const char* data, size_t pos, size_t size) noexcept {
+    return findEscapeSse2(data, pos, size);
+}
+
+__attribute__((target("avx2"))) size_t findEscapeSimd(
+    const char* data, size_t pos, size_t size) noexcept {
+    const auto ctrl = _mm256_set1_epi8(0x1f);
+    const auto del = _mm256_set1_epi8(0x7f);
+    const auto quote = _mm256_set1_epi8('"');
+    const auto backslash = _mm256_set1_epi8('\\');
+    for (; pos + 32 <= size; pos += 32) {
+        const auto v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        const auto m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl), v),
+                            _mm256_cmpeq_epi8(v, del)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                            _mm256_cmpeq_epi8(v, backslash)));
+        if (const auto mask =
+                static_cast<uint32_t>(_mm256_movemask_epi8(m));
+            mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    return findEscapeSse2(data, pos, size);
+}
+
+#endif
+
+}  // namespace
+
+size_t detail::findEscape(const char* data, size_t pos, size_t size) noexcept {
+#if defined(__x86_64__)
+    return findEscapeSimd(data, pos, size);
+#else
+    return findEscapeScalar(data, pos, size);
+#endif
+}
+
+void detail::appendJsonEscaped(std::string& out, std::string_view s) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    const char* data = s.data();
+    size_t begin = 0;
+    while (true) {
+        const auto pos = findEscape(data, begin, s.size());
+        out.append(data + begin, pos - begin);
+        if (pos == s.size()) break;
+        const auto c = static_cast<unsigned char>(data[pos]);
+        switch (c) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                out.append("\\u00");
+                out += kHex[c >> 4];
+                out += kHex[c & 0xf];
+        }
+        begin = pos + 1;
+    }
+}
+
+void JsonLogFormatter::format(std::string& out, const Logger& logger,
+                              LogLevel level, const LogEvent& event) const {
+    using detail::appendJsonEscaped;
+    out.append("{\"time\":\"");
+    detail::appendTime(out, "%Y-%m-%dT%H:%M:%S%z", event.time);
+    out.append("\",\"level\":\"");
+    out += toString(level);
+    out.append("\",\"logger\":\"");
+    appendJsonEscaped(out, logger.getName());
+    out.append("\",\"thread\":");
+    detail::appendNumber(out, event.thread_id);
+    if (event.file != nullptr) {
+        out.append(",\"file\":\"");
+        appendJsonEscaped(out, event.file);
+        out.append("\",\"line\":");
+        detail::appendNumber(out, event.line);
+    }
+    out.append(",\"msg\":\"");
+    appendJsonEscaped(out, event.content);
+    out += '"';
+    detail::forEachField(event.fields, [&out](std::string_view key,
+                                              std::string_view value,
+                                              bool quoted) {
+        out.append(",\"");
+        appendJsonEscaped(out, key);
+        out.append("\":");
+        if (quoted) {
+            out += '"';
+            appendJsonEscaped(out, value);
+            out += '"';
+        } else {
+            out += value;
+        }
+    });
+    out.append("}\n");
+}
+
+}  // namespace skyline::logger
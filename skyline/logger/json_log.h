@@ -0,0 +1,49 @@
+/**
+ * 结构化日志：每条日志输出为一行 JSON 对象，日志采集可以直接解析，不需要正则
+ *
+ * 固定的成员在前，field() 附加的字段按添加的顺序在后，不检查重名：
+ *      {"time":"2026-10-18T12:00:00+0800","level":"INFO","logger":"root",
+ *       "thread":1234,"file":"main.cc","line":10,"msg":"...","status":200}
+ *
+ * 字符串的转义由向量化的扫描完成：SSE2 每次检查 16 字节，运行时支持 AVX2 时
+ * 每次检查 32 字节，只在遇到需要转义的字符时才逐个处理，大段内容的转义开销
+ * 接近一次内存复制
+ *
+ * example:
+ *      appender->setFormatter(std::make_shared<JsonLogFormatter>());
+ *      SKYLINE_LOG_INFO(logger) << "request done" << field("status", 200);
+ **/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "log.h"
+
+namespace skyline::logger {
+
+namespace detail {
+
+// 返回 [pos, size) 中第一个需要转义的字符的位置，没有时返回 size
+// 需要转义的字符：引号、反斜杠、控制字符和 DEL
+size_t findEscape(const char* data, size_t pos, size_t size) noexcept;
+
+// 按 JSON 字符串的规则转义后追加到 out，不包括两侧的引号
+void appendJsonEscaped(std::string& out, std::string_view s);
+
+}  // namespace detail
+
+class JsonLogFormatter : public LogFormatter {
+public:
+    JsonLogFormatter() = default;
+
+    using LogFormatter::format;
+
+    // 追加一行 JSON，包括换行
+    void format(std::string& out, const Logger& logger, LogLevel level,
+                const LogEvent& event) const override;
+};
+
+}  // namespace skyline::logger
@@ -1,46 +1,127 @@
 #include "log.h"
 
 #include <cstdarg>
-#include <iomanip>
+#include <ctime>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 
 /**
  * features:
  * C++11:
  *  function(lambda), shared_ptr, unique_ptr, unordered_set, unordered_map
- *  enum class, move, put_time, emplace
+ *  enum class, move, emplace, thread_local
  * C++17:
- *  string_view
+ *  string_view, to_chars
  * C++20:
- *  unordered_map::contains
+ *  class type non-type template parameter
+ *  constinit, heterogeneous lookup
  **/
 
 namespace skyline::logger {
 
-std::ostream& operator<<(std::ostream& os, LogLevel level) {
+std::string_view toString(LogLevel level) noexcept {
     switch (level) {
 #define _FUNCTION(name)  \
     case LogLevel::name: \
-        return os << #name;
+        return #name;
         FOREACH_LOG_LEVEL(_FUNCTION)
 #undef _FUNCTION
         default:
-            return os << "UNKNOW";
+            return "UNKNOW";
     }
 }
 
+std::ostream& operator<<(std::ostream& os, LogLevel level) {
+    return os << toString(level);
+}
+
 std::string format(const char* fmt, ...) {
     va_list al;
     va_start(al, fmt);
     char* buf = nullptr;
     int len = vasprintf(&buf, fmt, al);
-    if (len != -1) {
-        auto res = std::string(buf, len);
-        free(buf);
-        return res;
+    va_end(al);
+    if (len == -1) return "";
+    auto res = std::string(buf, len);
+    free(buf);
+    return res;
+}
+
+void detail::appendFloat(std::string& out, double v) {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof buf, v,
+                             std::chars_format::general, 6);
+    out.append(buf, res.ptr);
+}
+
+void detail::appendPointer(std::string& out, const void* p) {
+    if (p == nullptr) {
+        out += '0';
+        return;
     }
+    char buf[20] = {'0', 'x'};
+    auto res = std::to_chars(buf + 2, buf + sizeof buf,
+                             reinterpret_cast<uintptr_t>(p), 16);
+    out.append(buf, res.ptr);
+}
+
+void detail::appendPrintf(std::string& out, const char* fmt, ...) {
+    va_list al;
+    va_start(al, fmt);
+    va_list copy;
+    va_copy(copy, al);
+    char buf[512];
+    int len = std::vsnprintf(buf, sizeof buf, fmt, al);
+    if (len >= 0 && static_cast<size_t>(len) < sizeof buf) {
+        out.append(buf, len);
+    } else if (len >= 0) {
+        const auto old = out.size();
+        out.resize(old + len + 1);
+        std::vsnprintf(out.data() + old, len + 1, fmt, copy);
+        out.resize(old + len);
+    }
+    va_end(copy);
     va_end(al);
-    return "";
+}
+
+size_t detail::appendUntilPlaceholder(std::string& out, std::string_view fmt,
+                                      size_t pos) {
+    size_t start = pos;
+    for (; pos + 1 < fmt.size(); ++pos) {
+        const char c = fmt[pos];
+        if (c != '{' && c != '}') continue;
+        out.append(fmt.data() + start, pos - start);
+        // {{ 和 }} 输出一个字符，{} 为占位符
+        if (c == '{' && fmt[pos + 1] == '}') return pos + 2;
+        out += c;
+        start = ++pos + 1;
+    }
+    if (start < fmt.size()) out.append(fmt.data() + start, fmt.size() - start);
+    return fmt.size();
+}
+
+void detail::appendFieldsText(std::string& out, std::string_view fields) {
+    forEachField(fields, [&out](std::string_view key, std::string_view value,
+                                bool) {
+        out += ' ';
+        out += key;
+        out += '=';
+        out += value;
+    });
+}
+
+detail::StringOStream::int_type detail::StringOStream::overflow(int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        _out.push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize detail::StringOStream::xsputn(const char* s,
+                                              std::streamsize n) {
+    _out.append(s, n);
+    return n;
 }
 
 LogEvent::LogEvent(std::source_location loc)
@@ -56,13 +137,36 @@ LogEvent::LogEvent(std::string content, std::source_location loc)
 
 // ---------------------------- LogEventWrap ----------------------------
 
+// 线程本地复用的日志内容缓冲区，超过该大小时不再保留
+static constexpr size_t kMaxRetainedContent = 64 * 1024;
+static thread_local std::string kLocalContent;
+static thread_local std::string kLocalFields;
+
 LogEventWrap::LogEventWrap(Logger& logger, LogLevel level,
                            LogEvent event) noexcept
-    : _logger(logger), _level(level), _event(std::move(event)) {}
+    : _logger(logger), _level(level), _event(std::move(event)) {
+    // 借用线程本地的缓冲区，嵌套使用时借到的是空 string
+    _event.content.clear();
+    _event.content.swap(kLocalContent);
+    _event.fields.clear();
+    _event.fields.swap(kLocalFields);
+}
 
 LogEventWrap::~LogEventWrap() {
-    _event.content = _ss.str();
+    if (_suppressed > 0) {
+        _event.content.append(" [");
+        detail::appendNumber(_event.content, _suppressed);
+        _event.content.append(" similar logs suppressed]");
+    }
     _logger.log(_level, _event);
+    if (_event.content.capacity() <= kMaxRetainedContent) {
+        _event.content.clear();
+        _event.content.swap(kLocalContent);
+    }
+    if (_event.fields.capacity() <= kMaxRetainedContent) {
+        _event.fields.clear();
+        _event.fields.swap(kLocalFields);
+    }
 }
 
 // ---------------------------- Logger ----------------------------
@@ -98,8 +202,8 @@ const std::string& Logger::getName() const { return _name; }
 
 // ---------------------------- Appender ----------------------------
 
-static LogFormatter::ptr kDefaultFormatter = std::make_shared<LogFormatter>(
-    "%d{%Y-%m-%d %H:%M:%S}%T%t%T[%p]%T[%c]%T%f:%l%T%m%n");
+static LogFormatter::ptr kDefaultFormatter = std::make_shared<
+    StaticLogFormatter<"%d{%Y-%m-%d %H:%M:%S}%T%t%T[%p]%T[%c]%T%f:%l%T%m%n">>();
 LogAppender::LogAppender() : LogAppender(kDefaultFormatter) {}
 
 LogAppender::LogAppender(LogFormatter::ptr formatter)
@@ -133,50 +237,56 @@ void FileLogAppender::log(const Logger& logger, LogLevel level,
 // ---------------------------- Formatter ----------------------------
 
 LogFormatter::LogFormatter(const std::string_view& pattern) {
-    for (size_t i = 0, start = 0; i < pattern.size(); ++i) {
+    auto add_string = [&](std::string_view str) {
+        if (str.empty()) return;
+        _items.push_back([str = std::string(str)](
+                             std::string& out, const Logger& logger,
+                             LogLevel level,
+                             const LogEvent& event) { out += str; });
+    };
+    size_t start = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
         if (pattern[i] != '%') continue;
-        if (i > start) {  // string item
-            _items.push_back([str = pattern.substr(start, i - start)](
-                                 std::ostream& os, const Logger& logger,
-                                 LogLevel level,
-                                 const LogEvent& event) { os << str; });
-        }
+        add_string(pattern.substr(start, i - start));  // string item
+        start = pattern.size();
         if (i + 1 >= pattern.size()) break;
         switch (pattern[++i]) {
             case 'm':  // content item
-                _items.push_back(
-                    [](std::ostream& os, const Logger& logger, LogLevel level,
-                       const LogEvent& event) { os << event.content; });
+                _items.push_back([](std::string& out, const Logger& logger,
+                                    LogLevel level, const LogEvent& event) {
+                    out += event.content;
+                    if (!event.fields.empty()) {
+                        detail::appendFieldsText(out, event.fields);
+                    }
+                });
                 break;
             case 'p':  // level item
-                _items.push_back([](std::ostream& os, const Logger& logger,
-                                    LogLevel level,
-                                    const LogEvent& event) { os << level; });
+                _items.push_back(
+                    [](std::string& out, const Logger& logger, LogLevel level,
+                       const LogEvent& event) { out += toString(level); });
                 break;
             case 'r':  // elapse item
-                _items.push_back(
-                    [](std::ostream& os, const Logger& logger, LogLevel level,
-                       const LogEvent& event) { os << event.elapse; });
+                _items.push_back([](std::string& out, const Logger& logger,
+                                    LogLevel level, const LogEvent& event) {
+                    detail::appendNumber(out, event.elapse);
+                });
                 break;
             case 'c':  // logger item
                 _items.push_back(
-                    [](std::ostream& os, const Logger& logger, LogLevel level,
-                       const LogEvent& event) { os << logger.getName(); });
+                    [](std::string& out, const Logger& logger, LogLevel level,
+                       const LogEvent& event) { out += logger.getName(); });
                 break;
             case 't':  // thread item
-                _items.push_back(
-                    [](std::ostream& os, const Logger& logger, LogLevel level,
-                       const LogEvent& event) { os << event.thread_id; });
+                _items.push_back([](std::string& out, const Logger& logger,
+                                    LogLevel level, const LogEvent& event) {
+                    detail::appendNumber(out, event.thread_id);
+                });
                 break;
             case 'T':  // tab item
-                _items.push_back([](std::ostream& os, const Logger& logger,
-                                    LogLevel level,
-                                    const LogEvent& event) { os << '\t'; });
+                add_string("\t");
                 break;
             case 'n':  // new line item
-                _items.push_back([](std::ostream& os, const Logger& logger,
-                                    LogLevel level,
-                                    const LogEvent& event) { os << '\n'; });
+                add_string("\n");
                 break;
             case 'd':  // date item
             {
@@ -191,33 +301,61 @@ LogFormatter::LogFormatter(const std::string_view& pattern) {
                     i = it;
                     return std::string(pattern, start, it - start);
                 }();
-                _items.push_back([fmt](std::ostream& os, const Logger& logger,
+                _items.push_back([fmt](std::string& out, const Logger& logger,
                                        LogLevel level, const LogEvent& event) {
-                    os << std::put_time(std::localtime(&event.time),
-                                        fmt.c_str());
+                    detail::appendTime(out, fmt.c_str(), event.time);
                 });
                 break;
             }
             case 'f':  // file item
-                _items.push_back(
-                    [](std::ostream& os, const Logger& logger, LogLevel level,
-                       const LogEvent& event) { os << event.file; });
+                _items.push_back([](std::string& out, const Logger& logger,
+                                    LogLevel level, const LogEvent& event) {
+                    if (event.file != nullptr) out += event.file;
+                });
                 break;
             case 'l':  // line item
-                _items.push_back(
-                    [](std::ostream& os, const Logger& logger, LogLevel level,
-                       const LogEvent& event) { os << event.line; });
+                _items.push_back([](std::string& out, const Logger& logger,
+                                    LogLevel level, const LogEvent& event) {
+                    detail::appendNumber(out, event.line);
+                });
                 break;
             default:  // 忽略其它情况
                 --i;
         }
         start = i + 1;
     }
+    if (start < pattern.size()) add_string(pattern.substr(start));
 }
 
 void LogFormatter::format(std::ostream& os, const Logger& logger,
                           LogLevel level, const LogEvent& event) const {
-    for (auto& i : _items) i(os, logger, level, event);
+    static thread_local std::string line;
+    line.clear();
+    format(line, logger, level, event);
+    os.write(line.data(), line.size());
+}
+
+void LogFormatter::format(std::string& out, const Logger& logger,
+                          LogLevel level, const LogEvent& event) const {
+    for (auto& i : _items) i(out, logger, level, event);
+}
+
+void detail::appendTime(std::string& out, const char* fmt, time_t time) {
+    struct Cache {
+        time_t time{-1};
+        std::string fmt;
+        char buf[128];
+        size_t len{0};
+    };
+    static thread_local Cache cache;
+    if (cache.time != time || cache.fmt != fmt) {
+        std::tm tm;
+        localtime_r(&time, &tm);
+        cache.len = std::strftime(cache.buf, sizeof cache.buf, fmt, &tm);
+        cache.time = time;
+        cache.fmt = fmt;
+    }
+    out.append(cache.buf, cache.len);
 }
 
 // ---------------------------- LoggerManager ----------------------------
@@ -232,15 +370,50 @@ Logger& getRootLogger() noexcept {
     return root_logger;
 }
 
-static std::unordered_map<std::string, Logger> kLoggers;
-static std::mutex kLoggerMutex;
-Logger& getLogger(const std::string& name) {
-    kLoggerMutex.lock();
-    if (!kLoggers.contains(name)) {
-        kLoggers.emplace(name, Logger(name));
+namespace {
+
+struct LoggerNameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const noexcept {
+        return std::hash<std::string_view>{}(name);
     }
-    kLoggerMutex.unlock();
-    return kLoggers.find(name)->second;
+};
+
+// 日志器表的不可变快照，插入时复制出新的快照再发布
+// 旧快照可能仍被其它线程读取，由新快照持有，不会释放（日志器只在启动时创建，数量很少）
+struct LoggerRegistry {
+    std::unordered_map<std::string, Logger*, LoggerNameHash, std::equal_to<>>
+        loggers;
+    std::unique_ptr<const LoggerRegistry> prev;
+};
+
+}  // namespace
+
+static constinit std::atomic<const LoggerRegistry*> kLoggers{nullptr};
+static std::mutex kLoggerMutex;  // 串行化插入
+
+static Logger* findLogger(const LoggerRegistry* registry,
+                          std::string_view name) {
+    if (registry == nullptr) return nullptr;
+    auto it = registry->loggers.find(name);
+    return it == registry->loggers.end() ? nullptr : it->second;
+}
+
+Logger& getLogger(std::string_view name) {
+    const auto* registry = kLoggers.load(std::memory_order_acquire);
+    if (auto* logger = findLogger(registry, name)) return *logger;
+
+    std::lock_guard<std::mutex> lock(kLoggerMutex);
+    const auto* current = kLoggers.load(std::memory_order_relaxed);
+    if (auto* logger = findLogger(current, name)) return *logger;
+
+    auto next = std::make_unique<LoggerRegistry>();
+    if (current != nullptr) next->loggers = current->loggers;
+    next->prev.reset(current);
+    auto* logger = new Logger(std::string(name));
+    next->loggers.emplace(name, logger);
+    kLoggers.store(next.release(), std::memory_order_release);
+    return *logger;
 }
 
 uint32_t getThreadID() {
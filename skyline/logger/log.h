@@ -11,6 +11,7 @@
  *      auto& logger = skyline::logger::getRootLogger();
  *      SKYLINE_LOG_DEBUG(logger) << "test log";
  *      LOG_FMT_DEBUG(logger, "%s", "test log");
+ *      LOG_FORMAT_DEBUG(logger, "{}", "test log");
  *
  * tip:
  * 由于Appender可以被多个Logger同时使用，因此它的线程安全由其子类实现处理
@@ -19,16 +20,35 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ctime>
 #include <fstream>
 #include <functional>
 #include <memory>
+#include <ostream>
 #include <source_location>
-#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_set>
 
 #define SKYLINE_LOG(log, lv) \
     if (log.level <= lv) skyline::logger::LogEventWrap(log, lv)
 
+// 在调用处缓存 getLogger(name) 的结果，之后只剩一次静态变量的初始化检查
+// name 需要是字符串字面量等常量
+// example: SKYLINE_LOG_INFO(SKYLINE_LOGGER("http")) << "...";
+#define SKYLINE_LOGGER(name)                              \
+    ([]() -> skyline::logger::Logger& {                   \
+        static skyline::logger::Logger& _skyline_logger = \
+            skyline::logger::getLogger(name);             \
+        return _skyline_logger;                           \
+    }())
+
 #define SKYLINE_LOG_DEBUG(log) \
     SKYLINE_LOG(log, skyline::logger::LogLevel::DEBUG)
 #define SKYLINE_LOG_INFO(log) SKYLINE_LOG(log, skyline::logger::LogLevel::INFO)
@@ -38,6 +58,35 @@
 #define SKYLINE_LOG_FATAL(log) \
     SKYLINE_LOG(log, skyline::logger::LogLevel::FATAL)
 
+// 限流：每个调用处每秒最多输出 n 条，超出的被丢弃并计数，
+// 之后输出的第一条日志末尾附带被抑制的条数；检查只有一次原子加
+// example: SKYLINE_LOG_LIMIT_WARN(logger, 10) << "bad request from " << ip;
+#define SKYLINE_LOG_LIMIT(log, lv, n)                            \
+    if (uint64_t _skyline_suppressed = 0;                        \
+        log.level <= lv &&                                       \
+        ([]() -> skyline::logger::LogRateLimit& {                \
+            static skyline::logger::LogRateLimit _skyline_limit; \
+            return _skyline_limit;                               \
+        }())                                                     \
+            .acquire(n, _skyline_suppressed))                    \
+    skyline::logger::LogEventWrap(log, lv).suppressed(_skyline_suppressed)
+
+// 采样：以 rate（0 到 1）的概率输出，使用线程本地的随机数，不访问共享变量
+#define SKYLINE_LOG_SAMPLE(log, lv, rate)                          \
+    if (log.level <= lv && skyline::logger::detail::sampled(rate)) \
+    skyline::logger::LogEventWrap(log, lv)
+
+#define SKYLINE_LOG_LIMIT_DEBUG(log, n) \
+    SKYLINE_LOG_LIMIT(log, skyline::logger::LogLevel::DEBUG, n)
+#define SKYLINE_LOG_LIMIT_INFO(log, n) \
+    SKYLINE_LOG_LIMIT(log, skyline::logger::LogLevel::INFO, n)
+#define SKYLINE_LOG_LIMIT_WARN(log, n) \
+    SKYLINE_LOG_LIMIT(log, skyline::logger::LogLevel::WARN, n)
+#define SKYLINE_LOG_LIMIT_ERROR(log, n) \
+    SKYLINE_LOG_LIMIT(log, skyline::logger::LogLevel::ERROR, n)
+#define SKYLINE_LOG_LIMIT_FATAL(log, n) \
+    SKYLINE_LOG_LIMIT(log, skyline::logger::LogLevel::FATAL, n)
+
 namespace skyline::logger {
 
 class Logger;
@@ -50,6 +99,36 @@ enum class LogLevel {
 #undef _FUNCTION
 };
 std::ostream& operator<<(std::ostream& os, LogLevel level);
+std::string_view toString(LogLevel level) noexcept;
+
+// 可以在运行时被其它线程修改的日志级别，用法与 LogLevel 相同
+// 读写都是 relaxed，判断级别是否开启只需要一次普通的读
+class AtomicLogLevel {
+public:
+    constexpr AtomicLogLevel(LogLevel level) noexcept : _level(level) {}
+    AtomicLogLevel(const AtomicLogLevel& other) noexcept
+        : _level(other.load()) {}
+
+    AtomicLogLevel& operator=(const AtomicLogLevel& other) noexcept {
+        store(other.load());
+        return *this;
+    }
+    AtomicLogLevel& operator=(LogLevel level) noexcept {
+        store(level);
+        return *this;
+    }
+    operator LogLevel() const noexcept { return load(); }
+
+    LogLevel load() const noexcept {
+        return _level.load(std::memory_order_relaxed);
+    }
+    void store(LogLevel level) noexcept {
+        _level.store(level, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<LogLevel> _level;
+};
 
 // 日志事件
 struct LogEvent {
@@ -59,6 +138,7 @@ struct LogEvent {
     uint32_t thread_id{0};      // 线程 id
     time_t time{0};             // 时间戳
     std::string content;
+    std::string fields;  // 结构化字段，见 field()，由 detail::forEachField 读取
 
     explicit LogEvent(
         std::source_location loc = std::source_location::current());
@@ -69,34 +149,287 @@ struct LogEvent {
 // 只为简化格式化输出
 std::string format(const char* fmt, ...);
 
+namespace detail {
+
+template <typename T>
+void appendNumber(std::string& out, T v) {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof buf, v);
+    out.append(buf, res.ptr);
+}
+
+// 与 std::ostream 的默认输出相同，即 %g
+void appendFloat(std::string& out, double v);
+void appendPointer(std::string& out, const void* p);
+void appendPrintf(std::string& out, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+// 追加 fmt 从 pos 开始到下一个 {} 之前的内容，返回 {} 之后的位置
+size_t appendUntilPlaceholder(std::string& out, std::string_view fmt,
+                              size_t pos);
+
+// 追加到 string 末尾的输出流，只用于没有更快方式的自定义类型
+class StringOStream : private std::streambuf, public std::ostream {
+public:
+    explicit StringOStream(std::string& out) : std::ostream(this), _out(out) {}
+
+private:
+    using int_type = std::streambuf::int_type;
+    using traits_type = std::streambuf::traits_type;
+
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+private:
+    std::string& _out;
+};
+
+template <typename T>
+concept LogValue =
+    std::is_arithmetic_v<std::decay_t<T>> ||
+    std::is_convertible_v<const T&, std::string_view> ||
+    std::is_pointer_v<std::decay_t<T>> ||
+    requires(std::ostream& os, const T& v) { os << v; };
+
+// 输出结果与 std::ostream 相同，常用类型不经过流
+template <LogValue T>
+void appendValue(std::string& out, const T& v) {
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, bool>) {
+        out += v ? '1' : '0';
+    } else if constexpr (std::is_same_v<U, char> ||
+                         std::is_same_v<U, signed char> ||
+                         std::is_same_v<U, unsigned char>) {
+        out += static_cast<char>(v);
+    } else if constexpr (std::is_integral_v<U>) {
+        appendNumber(out, v);
+    } else if constexpr (std::is_floating_point_v<U>) {
+        appendFloat(out, v);
+    } else if constexpr (std::is_same_v<U, const char*> ||
+                         std::is_same_v<U, char*>) {
+        if (v != nullptr) out += v;
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        out += std::string_view(v);
+    } else if constexpr (std::is_convertible_v<U, const void*>) {
+        appendPointer(out, v);
+    } else {
+        StringOStream os(out);
+        os << v;
+    }
+}
+
+// 结构化字段的编码：类型(1) | key 长度(4) | key | value 长度(4) | value
+// 类型 s 表示字符串，r 表示数值等无需加引号的值
+void appendFieldsText(std::string& out, std::string_view fields);
+
+template <LogValue T>
+void appendField(std::string& fields, std::string_view key, const T& v) {
+    using U = std::decay_t<T>;
+    char type = 's';
+    if constexpr (std::is_same_v<U, bool> ||
+                  (std::is_integral_v<U> && !std::is_same_v<U, char> &&
+                   !std::is_same_v<U, signed char> &&
+                   !std::is_same_v<U, unsigned char>)) {
+        type = 'r';
+    } else if constexpr (std::is_floating_point_v<U>) {
+        if (std::isfinite(v)) type = 'r';  // nan、inf 作为字符串
+    }
+    const auto key_len = static_cast<uint32_t>(key.size());
+    fields += type;
+    fields.append(reinterpret_cast<const char*>(&key_len), 4);
+    fields += key;
+    const auto pos = fields.size();
+    fields.append(4, '\0');
+    if constexpr (std::is_same_v<U, bool>) {
+        fields += v ? "true" : "false";
+    } else {
+        appendValue(fields, v);
+    }
+    const auto value_len = static_cast<uint32_t>(fields.size() - pos - 4);
+    std::memcpy(fields.data() + pos, &value_len, 4);
+}
+
+// 按添加的顺序遍历字段，f(key, value, quoted)
+template <typename F>
+void forEachField(std::string_view fields, F&& f) {
+    auto take = [&fields]() {
+        uint32_t len;
+        std::memcpy(&len, fields.data(), 4);
+        auto s = fields.substr(4, len);
+        fields.remove_prefix(4 + s.size());
+        return s;
+    };
+    while (!fields.empty()) {
+        const bool quoted = fields[0] == 's';
+        fields.remove_prefix(1);
+        const auto key = take();
+        const auto value = take();
+        f(key, value, quoted);
+    }
+}
+
+template <typename... Args>
+void formatTo(std::string& out, std::string_view fmt, const Args&... args) {
+    size_t pos = 0;
+    ((pos = appendUntilPlaceholder(out, fmt, pos), appendValue(out, args)),
+     ...);
+    appendUntilPlaceholder(out, fmt, pos);
+}
+
+// 返回 {} 的个数，格式错误时返回 -1
+consteval int countPlaceholders(std::string_view fmt) {
+    int count = 0;
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        if (fmt[i] == '{') {
+            if (i + 1 >= fmt.size()) return -1;
+            if (fmt[i + 1] == '}') ++count;
+            else if (fmt[i + 1] != '{') return -1;
+            ++i;
+        } else if (fmt[i] == '}') {
+            if (i + 1 >= fmt.size() || fmt[i + 1] != '}') return -1;
+            ++i;
+        }
+    }
+    return count;
+}
+
+}  // namespace detail
+
+// printf 风格的格式串，同时记录调用处的位置
+struct LogPrintfString {
+    LogPrintfString(
+        const char* str,
+        std::source_location loc = std::source_location::current()) noexcept
+        : str(str), loc(loc) {}
+
+    const char* str;
+    std::source_location loc;
+};
+
+// {} 风格的格式串，编译期检查占位符的数量与参数个数是否一致
+// 只支持 {} 和转义用的 {{、}}，参数的输出方式与流式输出相同
+template <typename... Args>
+struct BasicLogFormatString {
+    template <typename S>
+        requires std::is_convertible_v<const S&, std::string_view>
+    consteval BasicLogFormatString(
+        const S& s, std::source_location loc = std::source_location::current())
+        : str(s), loc(loc) {
+        if (detail::countPlaceholders(str) != sizeof...(Args)) {
+            throw "log format string does not match the arguments";
+        }
+    }
+
+    std::string_view str;
+    std::source_location loc;
+};
+
+template <typename... Args>
+using LogFormatString = BasicLogFormatString<std::type_identity_t<Args>...>;
+
+// 结构化日志的一个字段，只在输出语句中引用 key 和 value
+template <typename T>
+struct LogField {
+    std::string_view key;
+    const T& value;
+};
+
+// 为日志附加 key/value 字段，文本格式中输出在内容之后，
+// JsonLogFormatter 中输出为 JSON 对象的成员
+// example: SKYLINE_LOG_INFO(logger) << "request done"
+//              << field("status", 200) << field("path", path);
+template <detail::LogValue T>
+LogField<T> field(std::string_view key, const T& value) noexcept {
+    return {key, value};
+}
+
 // 日志事件包装器，只为简化流式输出
-// 注意：将忽略 event 本身的 content
+// 内容直接写入线程本地复用的 string，数值使用 to_chars 转换，不构造流，
+// 稳定后不再申请内存；嵌套使用时仍然正确，只是内层需要申请内存
+// 注意：将忽略 event 本身的 content 和 fields
 class LogEventWrap final {
 public:
     LogEventWrap(Logger& logger, LogLevel level,
                  LogEvent event = LogEvent()) noexcept;
     ~LogEventWrap();
 
+    template <detail::LogValue T>
+    friend LogEventWrap&& operator<<(LogEventWrap&& wrap, const T& t) {
+        detail::appendValue(wrap._event.content, t);
+        return std::move(wrap);
+    }
+
     template <typename T>
-    friend LogEventWrap&& operator<<(LogEventWrap&& wrap, T t)
-        requires requires(T x) { std::stringstream() << t; }
-    {
-        wrap._ss << t;
+    friend LogEventWrap&& operator<<(LogEventWrap&& wrap,
+                                     const LogField<T>& f) {
+        detail::appendField(wrap._event.fields, f.key, f.value);
         return std::move(wrap);
     }
 
+    // 日志内容，可以直接追加
+    std::string& content() noexcept { return _event.content; }
+
+    // 限流时被抑制的条数，不为 0 时附加在日志末尾
+    LogEventWrap&& suppressed(uint64_t n) && noexcept {
+        _suppressed = n;
+        return std::move(*this);
+    }
+
 private:
     Logger& _logger;
     LogLevel _level;
     LogEvent _event;
-    std::stringstream _ss;
+    uint64_t _suppressed{0};
+};
+
+// 调用处的限流状态，见 SKYLINE_LOG_LIMIT
+// 时间使用 CLOCK_MONOTONIC_COARSE，按整秒划分窗口，同一窗口内无论是否超出
+// 都只有一次 fetch_add；进入新窗口时由一个线程 CAS 重置计数，
+// 旧窗口中超出 limit 的部分即为被抑制的条数
+class LogRateLimit {
+public:
+    // 允许输出时返回 true，suppressed 为上一个有日志的窗口中被抑制的条数
+    bool acquire(uint32_t limit, uint64_t& suppressed) noexcept {
+        if (limit == 0) return false;
+        timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        const auto now = static_cast<uint64_t>(ts.tv_sec);
+        auto state = _state.load(std::memory_order_relaxed);
+        if ((state >> 32) != now &&
+            _state.compare_exchange_strong(state, now << 32 | 1,
+                                           std::memory_order_relaxed)) {
+            const auto count = state & 0xffffffff;
+            suppressed = count > limit ? count - limit : 0;
+            return true;
+        }
+        state = _state.fetch_add(1, std::memory_order_relaxed);
+        return (state >> 32) == now && (state & 0xffffffff) < limit;
+    }
+
+private:
+    std::atomic_uint64_t _state{0};  // 高 32 位为窗口的秒数，低 32 位为计数
 };
 
+namespace detail {
+
+// 以 rate 的概率返回 true，xorshift64 随机数
+inline bool sampled(double rate) noexcept {
+    static thread_local uint64_t x = 0;
+    if (x == 0) [[unlikely]] {
+        x = reinterpret_cast<uintptr_t>(&x) * 0x9e3779b97f4a7c15 | 1;
+    }
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return static_cast<double>(x >> 11) * 0x1.0p-53 < rate;
+}
+
+}  // namespace detail
+
 /**
  * 日志格式器
  *
  * 格式操作符：
- * %m -> message
+ * %m -> message，附加的字段以 key=value 的形式跟在其后
  * %p -> level
  * %r -> elapse
  * %c -> logger name
@@ -106,25 +439,157 @@ private:
  * %d{xx-xx} -> date
  * %f -> file
  * %l -> line
+ *
+ * 运行期解析格式，适合从配置中读取的格式；格式固定时使用 StaticLogFormatter
  **/
 class LogFormatter {
 public:
     using ptr = std::shared_ptr<LogFormatter>;
 
     LogFormatter(const std::string_view& pattern);
+    virtual ~LogFormatter() = default;
 
     void format(std::ostream& os, const Logger& logger, LogLevel level,
                 const LogEvent& event) const;
+    // 将格式化结果追加到 out 末尾
+    virtual void format(std::string& out, const Logger& logger, LogLevel level,
+                        const LogEvent& event) const;
+
+protected:
+    LogFormatter() = default;
 
 private:
     using FormatItemFunc =
-        std::function<void(std::ostream& os, const Logger& logger,
+        std::function<void(std::string& out, const Logger& logger,
                            LogLevel level, const LogEvent& event)>;
 
 private:
     std::vector<FormatItemFunc> _items;
 };
 
+// 用作模板参数的格式字符串
+template <size_t N>
+struct LogPattern {
+    constexpr LogPattern(const char (&s)[N]) {
+        for (size_t i = 0; i < N; ++i) str[i] = s[i];
+    }
+
+    char str[N]{};
+};
+
+namespace detail {
+
+// 追加 time 按 fmt 格式化后的结果，同一线程同一秒内只格式化一次
+void appendTime(std::string& out, const char* fmt, time_t time);
+
+// 编译期解析的格式项，s 表示 pool 中的字符串，d 表示 pool 中的日期格式，
+// 其它与格式操作符相同；%T、%n 会合并到相邻的字符串中
+struct PatternItem {
+    char kind{0};
+    uint16_t begin{0};
+    uint16_t len{0};
+};
+
+template <size_t N>
+struct CompiledPattern {
+    std::array<PatternItem, N> items{};
+    size_t count{0};
+    std::array<char, N * 10> pool{};  // 每个 %d 最多展开为默认的日期格式
+    size_t pool_size{0};
+};
+
+// 与 LogFormatter 的运行期解析规则相同
+template <LogPattern Pattern>
+constexpr auto compilePattern() {
+    constexpr size_t N = sizeof(Pattern.str);
+    constexpr std::string_view default_date = "%Y-%m-%d %H:%M:%S";
+    const std::string_view pattern(Pattern.str, N - 1);
+    CompiledPattern<N> res;
+    auto add_literal = [&](std::string_view str) {
+        if (str.empty()) return;
+        // 上一项也是字符串时，两者在 pool 中相邻，直接合并
+        if (res.count == 0 || res.items[res.count - 1].kind != 's') {
+            res.items[res.count++] = {'s', uint16_t(res.pool_size), 0};
+        }
+        for (char c : str) res.pool[res.pool_size++] = c;
+        res.items[res.count - 1].len += str.size();
+    };
+    size_t start = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') continue;
+        add_literal(pattern.substr(start, i - start));
+        start = pattern.size();
+        if (i + 1 >= pattern.size()) break;
+        switch (char kind = pattern[++i]) {
+            case 'T':
+                add_literal("\t");
+                break;
+            case 'n':
+                add_literal("\n");
+                break;
+            case 'd': {
+                auto fmt = default_date;
+                // 至少有一对大括号，才表示日期的格式
+                if (i + 2 < pattern.size() && pattern[i + 1] == '{') {
+                    auto it = pattern.find('}', i + 2);
+                    if (it != pattern.npos) {
+                        fmt = pattern.substr(i + 2, it - i - 2);
+                        i = it;
+                    }
+                }
+                res.items[res.count++] = {'d', uint16_t(res.pool_size),
+                                          uint16_t(fmt.size())};
+                for (char c : fmt) res.pool[res.pool_size++] = c;
+                res.pool[res.pool_size++] = '\0';  // strftime 需要
+                break;
+            }
+            case 'm':
+            case 'p':
+            case 'r':
+            case 'c':
+            case 't':
+            case 'f':
+            case 'l':
+                res.items[res.count++] = {kind, 0, 0};
+                break;
+            default:  // 忽略其它情况
+                --i;
+        }
+        start = i + 1;
+    }
+    if (start < pattern.size()) add_literal(pattern.substr(start));
+    return res;
+}
+
+}  // namespace detail
+
+/**
+ * 编译期解析格式的日志格式器，格式操作符与 LogFormatter 相同
+ * 展开为依次追加各项的代码，没有运行期的解析和逐项的类型擦除调用
+ *
+ * example:
+ *      auto formatter = std::make_shared<StaticLogFormatter<"%c%T%m%n">>();
+ **/
+template <LogPattern Pattern>
+class StaticLogFormatter : public LogFormatter {
+public:
+    using LogFormatter::format;
+
+    void format(std::string& out, const Logger& logger, LogLevel level,
+                const LogEvent& event) const override {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (append<kPattern.items[I]>(out, logger, level, event), ...);
+        }(std::make_index_sequence<kPattern.count>());
+    }
+
+private:
+    static constexpr auto kPattern = detail::compilePattern<Pattern>();
+
+    template <detail::PatternItem Item>
+    static void append(std::string& out, const Logger& logger, LogLevel level,
+                       const LogEvent& event);
+};
+
 // 日志输出地
 class LogAppender {
 public:
@@ -140,7 +605,7 @@ public:
     void setFormatter(LogFormatter::ptr formatter);
 
 public:
-    LogLevel level{LogLevel::DEBUG};
+    AtomicLogLevel level{LogLevel::DEBUG};
 
 protected:
     LogFormatter::ptr _formatter;  // 保证有一个可用的 formatter
@@ -165,13 +630,40 @@ public:
     const std::string& getName() const;
 
 public:
-    LogLevel level{LogLevel::DEBUG};
+    AtomicLogLevel level{LogLevel::DEBUG};
 
 private:
     std::string _name;
     std::unordered_set<LogAppender::ptr> _appenders;
 };
 
+template <LogPattern Pattern>
+template <detail::PatternItem Item>
+void StaticLogFormatter<Pattern>::append(std::string& out, const Logger& logger,
+                                         LogLevel level,
+                                         const LogEvent& event) {
+    if constexpr (Item.kind == 's') {
+        out.append(kPattern.pool.data() + Item.begin, Item.len);
+    } else if constexpr (Item.kind == 'd') {
+        detail::appendTime(out, kPattern.pool.data() + Item.begin, event.time);
+    } else if constexpr (Item.kind == 'm') {
+        out += event.content;
+        if (!event.fields.empty()) detail::appendFieldsText(out, event.fields);
+    } else if constexpr (Item.kind == 'p') {
+        out += toString(level);
+    } else if constexpr (Item.kind == 'r') {
+        detail::appendNumber(out, event.elapse);
+    } else if constexpr (Item.kind == 'c') {
+        out += logger.getName();
+    } else if constexpr (Item.kind == 't') {
+        detail::appendNumber(out, event.thread_id);
+    } else if constexpr (Item.kind == 'f') {
+        if (event.file != nullptr) out += event.file;
+    } else if constexpr (Item.kind == 'l') {
+        detail::appendNumber(out, event.line);
+    }
+}
+
 // 控制台
 class StdoutLogAppender : virtual public LogAppender {
 public:
@@ -199,23 +691,49 @@ private:
 // 请使用引用接收返回值，避免发生复制（除非明确需要一个复制的Logger）
 Logger& getRootLogger() noexcept;
 // 请使用引用接收返回值，避免发生复制，以便可以被管理器管理（除非明确需要一个复制的Logger）
-Logger& getLogger(const std::string& name);
+// 查找不加锁，只有第一次创建时加锁；创建的日志器直到程序退出都不会被销毁
+// 频繁调用的地方可以使用 SKYLINE_LOGGER(name) 在调用处缓存引用
+Logger& getLogger(std::string_view name);
 
 uint32_t getThreadID();
 
+// printf 风格
 template <typename... Args>
-void LOG_FMT(Logger& logger, LogLevel level, const char* fmt, Args&&... args) {
+void LOG_FMT(Logger& logger, LogLevel level, LogPrintfString fmt,
+             Args&&... args) {
     if (logger.level <= level) {
-        logger.log(level, LogEvent(format(fmt, args...)));
+        LogEventWrap wrap(logger, level, LogEvent(fmt.loc));
+        detail::appendPrintf(wrap.content(), fmt.str, args...);
     }
 }
 
 #define _FUNCTION(name)                                                    \
     template <typename... Args>                                            \
-    void LOG_FMT_##name(Logger& logger, const char* fmt, Args&&... args) { \
+    void LOG_FMT_##name(Logger& logger, LogPrintfString fmt,               \
+                        Args&&... args) {                                  \
         LOG_FMT(logger, LogLevel::name, fmt, args...);                     \
     }
 FOREACH_LOG_LEVEL(_FUNCTION)
 #undef _FUNCTION
 
+// {} 风格，格式串与参数不匹配时编译失败
+// example: LOG_FORMAT_INFO(logger, "{} {} -> {}", method, path, status);
+template <typename... Args>
+void LOG_FORMAT(Logger& logger, LogLevel level, LogFormatString<Args...> fmt,
+                const Args&... args) {
+    if (logger.level <= level) {
+        LogEventWrap wrap(logger, level, LogEvent(fmt.loc));
+        detail::formatTo(wrap.content(), fmt.str, args...);
+    }
+}
+
+#define _FUNCTION(name)                                                 \
+    template <typename... Args>                                         \
+    void LOG_FORMAT_##name(Logger& logger, LogFormatString<Args...> fmt, \
+                           const Args&... args) {                       \
+        LOG_FORMAT(logger, LogLevel::name, fmt, args...);               \
+    }
+FOREACH_LOG_LEVEL(_FUNCTION)
+#undef _FUNCTION
+
 }  // namespace skyline::logger
@@ -0,0 +1,300 @@
+#include "log_file.h"
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#include "log.h"
+
+namespace skyline::logger {
+
+static constexpr size_t kPageSize = 4096;
+
+static void reportError(const char* what, const std::string& filename) {
+    auto& logger = getRootLogger();
+    LOG_FMT_ERROR(logger, "log file `%s` %s fail: %s", filename.c_str(), what,
+                  strerror(errno));
+}
+
+static bool pwriteAll(int fd, const char* data, size_t length, size_t offset) {
+    while (length > 0) {
+        auto n = ::pwrite(fd, data, length, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= n;
+        offset += n;
+    }
+    return true;
+}
+
+LogFile::LogFile(const std::string& filename, LogFileOptions options)
+    : _filename(filename), _options(options) {
+    if (_options.direct_io) {
+        // 需要读回不满一块的尾部，因此以读写方式打开
+        _fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | O_DIRECT,
+                     0644);
+        if (_fd != -1) {
+            _direct = true;
+        } else {
+            auto& logger = getRootLogger();
+            LOG_FMT_WARN(logger, "log file `%s` O_DIRECT not supported: %s",
+                         filename.c_str(), strerror(errno));
+        }
+    }
+    if (_fd == -1) {
+        _fd = ::open(filename.c_str(),
+                     O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+    if (_fd == -1) {
+        reportError("open", filename);
+        return;
+    }
+    struct stat st;
+    if (::fstat(_fd, &st) == 0) _size = st.st_size;
+    _synced = _dropped = _size;
+
+    if (_direct) {
+        _stage.reset(new (std::align_val_t(kDirectAlign)) char[kDirectAlign]);
+        _stage_cap = kDirectAlign;
+        _offset = _size / kDirectAlign * kDirectAlign;
+        _tail = _size - _offset;
+        if (_tail > 0 && ::pread(_fd, _stage.get(), kDirectAlign, _offset) !=
+                             static_cast<ssize_t>(_tail)) {
+            reportError("read", filename);
+        }
+    }
+}
+
+LogFile::~LogFile() {
+    if (_fd == -1) return;
+    if (_direct) flushDirectTail();
+    ::close(_fd);
+}
+
+void LogFile::write(const char* data, size_t length) {
+    iovec iov{const_cast<char*>(data), length};
+    write(&iov, 1);
+}
+
+void LogFile::write(const iovec* iov, int count) {
+    if (_fd == -1) return;
+    if (_direct) {
+        writeDirect(iov, count);
+        return;
+    }
+    std::vector<iovec> rest(iov, iov + count);
+    size_t i = 0;
+    while (true) {
+        while (i < rest.size() && rest[i].iov_len == 0) ++i;
+        if (i == rest.size()) break;
+        auto n = ::writev(_fd, rest.data() + i,
+                          std::min<size_t>(rest.size() - i, IOV_MAX));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            reportError("write", _filename);
+            return;
+        }
+        _size += n;
+        // 跳过已写出的部分
+        for (; n > 0; ++i) {
+            if (static_cast<size_t>(n) < rest[i].iov_len) {
+                rest[i].iov_base = static_cast<char*>(rest[i].iov_base) + n;
+                rest[i].iov_len -= n;
+                break;
+            }
+            n -= rest[i].iov_len;
+        }
+    }
+}
+
+void LogFile::writeDirect(const iovec* iov, int count) {
+    auto total = _tail;
+    for (int i = 0; i < count; ++i) total += iov[i].iov_len;
+    if (total > _stage_cap) {
+        auto cap = (total + kDirectAlign - 1) / kDirectAlign * kDirectAlign;
+        std::unique_ptr<char[], AlignedDeleter> stage(
+            new (std::align_val_t(kDirectAlign)) char[cap]);
+        std::memcpy(stage.get(), _stage.get(), _tail);
+        _stage = std::move(stage);
+        _stage_cap = cap;
+    }
+    auto pos = _tail;
+    for (int i = 0; i < count; ++i) {
+        std::memcpy(_stage.get() + pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    // 整块写出，剩余部分移到开头等待下次写入
+    const auto full = total / kDirectAlign * kDirectAlign;
+    if (full > 0) {
+        if (!pwriteAll(_fd, _stage.get(), full, _offset)) {
+            reportError("write", _filename);
+            return;
+        }
+        _offset += full;
+        std::memmove(_stage.get(), _stage.get() + full, total - full);
+    }
+    _tail = total - full;
+    _size = _offset + _tail;
+}
+
+void LogFile::flushDirectTail() {
+    if (_tail == 0) return;
+    std::memset(_stage.get() + _tail, 0, kDirectAlign - _tail);
+    if (!pwriteAll(_fd, _stage.get(), kDirectAlign, _offset) ||
+        ::ftruncate(_fd, _offset + _tail) != 0) {
+        reportError("write", _filename);
+    }
+}
+
+void LogFile::sync() {
+    if (_fd == -1) return;
+    if (_direct) {
+        // 数据不经过页缓存，只需写出尾部
+        flushDirectTail();
+        if (_options.sync == LogFileSync::DATASYNC) ::fdatasync(_fd);
+        return;
+    }
+
+    const bool datasync = _options.sync == LogFileSync::DATASYNC;
+    if (datasync) {
+        ::fdatasync(_fd);
+    } else if ((_options.sync == LogFileSync::RANGE || _options.drop_cache) &&
+               _size > _synced) {
+        ::sync_file_range(_fd, _synced, _size - _synced,
+                          SYNC_FILE_RANGE_WRITE);
+    }
+    if (_options.drop_cache) {
+        // DONTNEED 只丢弃干净的页，等待上一次启动的写回完成后再丢弃
+        const auto end = datasync ? _size : _synced;
+        const auto start = _dropped / kPageSize * kPageSize;
+        if (end > start) {
+            if (!datasync) {
+                ::sync_file_range(_fd, start, end - start,
+                                  SYNC_FILE_RANGE_WAIT_BEFORE |
+                                      SYNC_FILE_RANGE_WRITE |
+                                      SYNC_FILE_RANGE_WAIT_AFTER);
+            }
+            ::posix_fadvise(_fd, start, end - start, POSIX_FADV_DONTNEED);
+            _dropped = end;
+        }
+    }
+    _synced = _size;
+}
+
+// ------------------------------- LogArchiver -------------------------------
+
+static constexpr size_t kCompressChunk = 64 * 1024;
+
+LogArchiver::LogArchiver(bool compress, size_t max_files)
+    : _compress(compress), _max_files(max_files) {
+    _thread = std::thread([this]() { run(); });
+}
+
+LogArchiver::~LogArchiver() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+void LogArchiver::add(std::string filename) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending.push_back(std::move(filename));
+    }
+    _cv.notify_one();
+}
+
+void LogArchiver::run() {
+    // 压缩只在空闲时进行，不与业务线程和写日志的线程争抢 CPU 和磁盘
+    ::setpriority(PRIO_PROCESS, ::gettid(), 19);
+    constexpr int kIOPrioClassIdle = 3, kIOPrioClassShift = 13;
+    ::syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, ::gettid(),
+              kIOPrioClassIdle << kIOPrioClassShift);
+
+    while (true) {
+        std::string filename;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this]() { return _stop || !_pending.empty(); });
+            if (_stop) return;
+            filename = std::move(_pending.front());
+            _pending.pop_front();
+        }
+
+        if (_compress && !filename.ends_with(".gz")) {
+            auto target = filename + ".gz";
+            if (compressFile(filename, target)) {
+                ::unlink(filename.c_str());
+                filename = std::move(target);
+            } else {
+                ::unlink(target.c_str());
+                if (_stop) return;
+            }
+        }
+        _files.push_back(std::move(filename));
+        while (_max_files > 0 && _files.size() > _max_files) {
+            ::unlink(_files.front().c_str());
+            _files.pop_front();
+        }
+    }
+}
+
+bool LogArchiver::compressFile(const std::string& filename,
+                               const std::string& target) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        reportError("open", filename);
+        return false;
+    }
+    gzFile gz = ::gzopen(target.c_str(), "wb");
+    if (gz == nullptr) {
+        reportError("open", target);
+        ::close(fd);
+        return false;
+    }
+    ::gzbuffer(gz, kCompressChunk);
+
+    std::unique_ptr<char[]> buf(new char[kCompressChunk]);
+    bool ok = true;
+    while (true) {
+        // 停止时放弃当前文件，由调用者删除不完整的压缩文件
+        if (_stop) {
+            ok = false;
+            break;
+        }
+        auto n = ::read(fd, buf.get(), kCompressChunk);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n < 0) reportError("read", filename);
+            ok = n == 0;
+            break;
+        }
+        if (::gzwrite(gz, buf.get(), n) != n) {
+            reportError("compress", target);
+            ok = false;
+            break;
+        }
+    }
+    // 读完后丢弃原文件的页缓存，它马上会被删除
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+    if (::gzclose(gz) != Z_OK) ok = false;
+    return ok;
+}
+
+}  // namespace skyline::logger
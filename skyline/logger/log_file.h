@@ -0,0 +1,108 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+namespace skyline::logger {
+
+// 每次 sync 时的持久化方式
+enum class LogFileSync {
+    NONE,      // 只写入页缓存，由内核决定何时写回
+    RANGE,     // sync_file_range 启动新数据的写回，不等待完成
+    DATASYNC,  // fdatasync 等待数据落盘
+};
+
+struct LogFileOptions {
+    LogFileSync sync{LogFileSync::NONE};
+    // 写回完成后 posix_fadvise(DONTNEED) 丢弃页缓存，避免日志挤占其它文件的缓存
+    bool drop_cache{false};
+    // O_DIRECT 绕过页缓存，数据先复制到对齐的缓冲区，不满一块的尾部每次 sync
+    // 时补零写出再截断，下次写入时覆盖；文件系统不支持时退回普通写入
+    bool direct_io{false};
+};
+
+// 日志文件，直接使用 fd 写入，一组缓冲区只需要一次 writev
+// 非线程安全
+class LogFile {
+public:
+    static constexpr size_t kDirectAlign = 4096;
+
+    LogFile(const std::string& filename, LogFileOptions options = {});
+    LogFile(const LogFile&) = delete;
+    ~LogFile();
+
+    bool isOpen() const noexcept { return _fd != -1; }
+    bool isDirect() const noexcept { return _direct; }
+    // 已写入的字节数，包括打开前已有的内容
+    size_t size() const noexcept { return _size; }
+
+    void write(const char* data, size_t length);
+    void write(const iovec* iov, int count);
+    // 按 options 持久化已写入的数据
+    void sync();
+
+private:
+    void writeDirect(const iovec* iov, int count);
+    void flushDirectTail();
+
+private:
+    struct AlignedDeleter {
+        void operator()(char* p) const noexcept {
+            ::operator delete[](p, std::align_val_t(kDirectAlign));
+        }
+    };
+
+    std::string _filename;
+    LogFileOptions _options;
+    int _fd{-1};
+    bool _direct{false};
+    size_t _size{0};
+    size_t _synced{0};   // 已启动写回的位置
+    size_t _dropped{0};  // 已丢弃缓存的位置
+
+    // O_DIRECT 使用：_offset 之前的数据已按块写出，之后的不满一块的数据
+    // 保存在 _stage 的开头
+    std::unique_ptr<char[], AlignedDeleter> _stage;
+    size_t _stage_cap{0};
+    size_t _offset{0};
+    size_t _tail{0};
+};
+
+// 已滚动日志文件的归档：后台线程以最低的 CPU 和 IO 优先级 gzip 压缩文件，
+// 压缩完成后删除原文件，再按 max_files 删除最旧的文件，不阻塞写日志的线程
+class LogArchiver {
+public:
+    // max_files 为 0 时不删除
+    LogArchiver(bool compress, size_t max_files);
+    LogArchiver(const LogArchiver&) = delete;
+    // 压缩到一半的文件会被放弃，未压缩的文件留待下次启动时处理
+    ~LogArchiver();
+
+    // 按从旧到新的顺序加入已滚动的文件，已是 .gz 的文件不再压缩
+    void add(std::string filename);
+
+private:
+    void run();
+    bool compressFile(const std::string& filename, const std::string& target);
+
+private:
+    const bool _compress;
+    const size_t _max_files;
+    std::deque<std::string> _pending;  // 等待处理，由 _mutex 保护
+    std::deque<std::string> _files;    // 已处理的文件，只在后台线程访问
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::atomic_bool _stop{false};  // 压缩过程中也会检查
+    std::thread _thread;
+};
+
+}  // namespace skyline::logger
@@ -0,0 +1,117 @@
+#include "log_ring.h"
+
+#include <bit>
+#include <thread>
+
+#include "log.h"
+
+namespace skyline::logger {
+
+using namespace std::chrono_literals;
+
+// 当前线程注册过的缓冲区，线程退出时通知消费者回收
+struct LocalRings {
+    std::vector<std::pair<uint64_t, std::shared_ptr<LogRing>>> rings;
+
+    ~LocalRings() {
+        for (auto& [id, ring] : rings) {
+            ring->orphaned.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static uint64_t nextRingSetID() {
+    static std::atomic_uint64_t id{0};
+    return ++id;
+}
+
+LogRingSet::LogRingSet() : _id(nextRingSetID()) {}
+
+void LogRingSet::push(std::string_view data) {
+    auto& ring = localRing();
+    for (int tries = 0; !ring.push(data); ++tries) {
+        const auto policy = _policy.load(std::memory_order_relaxed);
+        // 超过缓冲区大小的数据永远写不进去，不能等待；
+        // 消费者线程在处理数据时写入（例如写文件失败的报错）也不能等待自己
+        if (policy == RingFullPolicy::BLOCK && data.size() <= ring.capacity() &&
+            !_closed.load(std::memory_order_relaxed) &&
+            _consumer.load(std::memory_order_relaxed) !=
+                std::this_thread::get_id()) {
+            wakeup();
+            if (tries < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(1ms);
+            }
+            continue;
+        }
+        if (policy != RingFullPolicy::DROP_NEWEST) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    // 超过一半时提前唤醒消费者，避免等到下一个周期时已经写满
+    if (ring.used() > ring.capacity() / 2) wakeup();
+}
+
+void LogRingSet::wait(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _consumer.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    _cv.wait_for(lock, timeout, [&]() { return _wakeup || _closed; });
+    _wakeup = false;
+}
+
+LogRing& LogRingSet::localRing() {
+    static thread_local LocalRings local;
+    for (auto& [id, ring] : local.rings) {
+        if (id == _id) return *ring;
+    }
+    // 第一次写入，顺便清理已关闭的集合留下的缓冲区
+    std::erase_if(local.rings, [](const auto& item) {
+        return item.second->closed.load(std::memory_order_relaxed);
+    });
+    auto capacity = std::bit_ceil(std::max(
+        _ring_capacity.load(std::memory_order_relaxed), kMinRingCapacity));
+    auto ring = std::make_shared<LogRing>(capacity, getThreadID());
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rings.push_back(ring);
+    }
+    local.rings.emplace_back(_id, ring);
+    return *ring;
+}
+
+// 必须在锁内设置标志，否则可能在消费者检查条件之后、开始等待之前设置，
+// 通知丢失，消费者要等到超时才醒来
+void LogRingSet::wakeup() noexcept {
+    if (_wakeup.load(std::memory_order_relaxed)) return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_wakeup) return;
+        _wakeup = true;
+    }
+    _cv.notify_one();
+}
+
+void LogRingSet::close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed) return;
+    _closed = true;
+    for (auto& r : _rings) r->closed = true;
+    _cv.notify_all();
+}
+
+void LogRingSet::setRingCapacity(size_t capacity) noexcept {
+    _ring_capacity.store(capacity, std::memory_order_relaxed);
+}
+
+void LogRingSet::setFullPolicy(RingFullPolicy policy) noexcept {
+    _policy.store(policy, std::memory_order_relaxed);
+}
+
+uint64_t LogRingSet::droppedCount() const noexcept {
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace skyline::logger
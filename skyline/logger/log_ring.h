@@ -0,0 +1,166 @@
+/**
+ * 异步日志使用的缓冲区：
+ *      LogRing 单生产者单消费者的字节环形缓冲区
+ *      LogRingSet 为每个写日志的线程分配一个 LogRing，由一个后台线程统一取走
+ *
+ * 生产者只写入自己线程的缓冲区，不加锁；只有线程第一次写入时需要加锁注册
+ * 同一线程写入的数据保持顺序，不同线程之间不保证顺序
+ **/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace skyline::logger {
+
+// 环形缓冲区写满时的处理方式
+enum class RingFullPolicy {
+    BLOCK,         // 等待后台线程取走数据，后台线程自己写入时丢弃并计数
+    DROP_NEWEST,   // 直接丢弃新日志
+    DROP_COUNTED,  // 丢弃新日志并计数，后台线程会在输出中记录丢弃的条数
+};
+
+// 每次写入的数据整体写入后才移动 _head，消费者看到的总是完整的数据
+class LogRing {
+public:
+    LogRing(size_t capacity, uint32_t thread_id)
+        : thread_id(thread_id),
+          _data(new char[capacity]),
+          _capacity(capacity) {}
+
+    // 生产者调用，空间不足时返回 false
+    bool push(std::string_view data) noexcept {
+        const auto head = _head.load(std::memory_order_relaxed);
+        if (_capacity - (head - _cached_tail) < data.size()) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if (_capacity - (head - _cached_tail) < data.size()) return false;
+        }
+        const auto pos = head & (_capacity - 1);
+        const auto first = std::min(data.size(), _capacity - pos);
+        std::memcpy(_data.get() + pos, data.data(), first);
+        std::memcpy(_data.get(), data.data() + first, data.size() - first);
+        _head.store(head + data.size(), std::memory_order_release);
+        return true;
+    }
+
+    // 生产者调用，_cached_tail 可能落后，结果偏大
+    size_t used() const noexcept {
+        return _head.load(std::memory_order_relaxed) - _cached_tail;
+    }
+
+    size_t capacity() const noexcept { return _capacity; }
+
+    // 消费者调用，取走当前所有数据，每段连续的内存调用一次 f
+    template <typename F>
+    void pop(F&& f) {
+        const auto tail = _tail.load(std::memory_order_relaxed);
+        const auto head = _head.load(std::memory_order_acquire);
+        if (head == tail) return;
+        const auto pos = tail & (_capacity - 1);
+        const auto first = std::min(head - tail, _capacity - pos);
+        f(std::string_view(_data.get() + pos, first));
+        if (head - tail > first) {
+            f(std::string_view(_data.get(), head - tail - first));
+        }
+        _tail.store(head, std::memory_order_release);
+    }
+
+public:
+    const uint32_t thread_id;
+    std::atomic_uint64_t dropped{0};   // 尚未报告的丢弃次数
+    std::atomic_bool closed{false};    // 所属的 LogRingSet 已关闭
+    std::atomic_bool orphaned{false};  // 生产者线程已退出
+
+private:
+    std::unique_ptr<char[]> _data;
+    const size_t _capacity;
+    alignas(64) std::atomic_size_t _head{0};
+    size_t _cached_tail{0};  // 生产者最近一次看到的 _tail
+    alignas(64) std::atomic_size_t _tail{0};
+};
+
+class LogRingSet {
+public:
+    static constexpr size_t kDefaultRingCapacity = 1 << 20;
+    static constexpr size_t kMinRingCapacity = 4096;
+    // 没有被提前唤醒时，消费者取数据的间隔
+    static constexpr std::chrono::milliseconds kDrainInterval{100};
+
+    LogRingSet();
+    LogRingSet(const LogRingSet&) = delete;
+    ~LogRingSet() { close(); }
+
+    // 生产者调用，写入当前线程的缓冲区，写满时按策略处理
+    void push(std::string_view data);
+
+    // 消费者调用，等待至多 timeout，缓冲区超过一半或者关闭时提前返回
+    void wait(std::chrono::milliseconds timeout);
+
+    // 消费者调用，取走所有缓冲区的数据，每段数据调用一次 f
+    // 有丢弃时调用 on_dropped(丢弃次数, 线程 id)，已退出线程的缓冲区取完后释放
+    template <typename F, typename D>
+    void drain(F&& f, D&& on_dropped) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _consumer.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        std::erase_if(_rings, [&](const std::shared_ptr<LogRing>& r) {
+            // 先确认生产者已退出再取数据，保证取完后不会再有写入
+            const bool orphaned = r->orphaned;
+            r->pop(f);
+            if (auto n = r->dropped.exchange(0)) on_dropped(n, r->thread_id);
+            return orphaned;
+        });
+    }
+
+    // 消费者线程的主循环，直到关闭后取完剩余的数据才返回
+    // 每轮等待 kDrainInterval 或被提前唤醒，用 f 和 on_dropped 取走所有数据后
+    // 调用 after_drain(是否最后一轮)，在其中写出本轮取到的数据
+    // 同一次 push 的数据总是整体取出，按顺序拼接 f 收到的数据不会截断记录
+    template <typename F, typename D, typename A>
+    void run(F&& f, D&& on_dropped, A&& after_drain) {
+        while (true) {
+            const bool stop = closed();
+            if (!stop) wait(kDrainInterval);
+            drain(f, on_dropped);
+            after_drain(stop);
+            if (stop) break;
+        }
+    }
+
+    // 唤醒消费者，之后 BLOCK 策略不再等待
+    void close();
+    bool closed() const noexcept { return _closed; }
+
+    // 每个线程的缓冲区大小，向上取整为 2 的幂，只影响之后注册的线程
+    void setRingCapacity(size_t capacity) noexcept;
+    void setFullPolicy(RingFullPolicy policy) noexcept;
+    // DROP_COUNTED 策略下累计丢弃的次数
+    uint64_t droppedCount() const noexcept;
+
+private:
+    LogRing& localRing();
+    void wakeup() noexcept;
+
+private:
+    const uint64_t _id;  // 区分不同的实例，线程本地缓存以此查找缓冲区
+    std::vector<std::shared_ptr<LogRing>> _rings;  // 由 _mutex 保护
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::atomic_bool _closed{false};
+    std::atomic_bool _wakeup{false};  // 由 _mutex 保护，无锁读取只用于快速判断
+    // 最近一次调用 wait/drain 的线程，它写满时不能等待自己
+    std::atomic<std::thread::id> _consumer{};
+    std::atomic_size_t _ring_capacity{kDefaultRingCapacity};
+    std::atomic<RingFullPolicy> _policy{RingFullPolicy::BLOCK};
+    std::atomic_uint64_t _dropped{0};
+};
+
+}  // namespace skyline::logger